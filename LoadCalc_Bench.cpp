@@ -0,0 +1,570 @@
+// LoadCalc_Bench.cpp (C++17)
+// Benchmark harness for the planner hot paths: DB loading, ULD width lookup, placement, deck
+// rendering and late re-planning, timed separately over synthetic flights for every aircraft in
+// aircraft_db.json. Also records and verifies a regression corpus (see "Regression corpus").
+#define LOADCALC_NO_MAIN
+#include "LoadCalc_CPP.cpp"
+#include <random>
+
+// ===== Timing =====
+using BenchClock = chrono::steady_clock;
+
+struct BenchStats {
+    string name;
+    vector<double> samplesUs{}; // one sample per timed operation
+};
+
+double elapsedUs(BenchClock::time_point since) {
+    return chrono::duration<double, micro>(BenchClock::now() - since).count();
+}
+
+void printStats(BenchStats& st, const string& unit) {
+    if (st.samplesUs.empty()) return;
+    sort(st.samplesUs.begin(), st.samplesUs.end());
+    double total = 0.0;
+    for (double v : st.samplesUs) total += v;
+    size_t n = st.samplesUs.size();
+    double p50 = st.samplesUs[n / 2];
+    double p99 = st.samplesUs[min(n - 1, n * 99 / 100)];
+    cout << left << setw(22) << st.name << right << fixed << setprecision(2)
+        << setw(12) << (total > 0 ? n / (total / 1e6) : 0.0) << " " << left << setw(10) << unit + "/s" << right
+        << setw(12) << p50 << setw(12) << p99 << setw(10) << n << defaultfloat << "\n";
+}
+
+// ===== Synthetic flights =====
+ULD::Type uldTypeForDeck(const string& deck) {
+    if (deck == "Main") return ULD::Type::MAIN;
+    if (deck == "Lower") return ULD::Type::LOWER;
+    return ULD::Type::ANY;
+}
+
+// Random ULD mix drawn from the ULD DB, sized to roughly fill the aircraft (60-110% of its slots)
+vector<ULD> makeSyntheticFlight(const Aircraft& ac, const ULDDB& ulddb, mt19937& rng) {
+    vector<ULD> ulds;
+    int slots = ac.mainDeck.slots + ac.lowerDeck.slots;
+    if (slots == 0 || ulddb.entries.empty()) return ulds;
+
+    uniform_int_distribution<size_t> pick(0, ulddb.entries.size() - 1);
+    uniform_real_distribution<double> fill(0.6, 1.1), weight(200.0, 5000.0);
+    uniform_int_distribution<int> serial(10000, 99999), coin(0, 1);
+
+    int target = max(1, (int)(slots * fill(rng)));
+    for (int used = 0; used < target;) {
+        const ULDDBEntry& e = ulddb.entries[pick(rng)];
+        ULD u;
+        u.id = e.prefix + to_string(serial(rng)) + "XX";
+        u.weight = round(weight(rng));
+        u.type = uldTypeForDeck(e.deck);
+        u.allowSpecialSlots = coin(rng) == 1;
+        ulds.push_back(u);
+        used += max(1, e.widthSlots);
+    }
+    return ulds;
+}
+
+// ===== Regression corpus =====
+// `--record <dir>` writes a corpus: synthetic manifests for every aircraft (manifest.json, in the
+// batch manifest format), each engine's assignments for them (golden.jsonl) and per-engine timing
+// and arena peak (baseline.json). The corpus in corpus/ is committed; `--verify <dir>` re-plans it
+// with every engine and fails when:
+// - greedy assignments, CG or moment differ from the golden ones in any bit
+// - a lower-dp or optimize plan differs from its golden plan without being better: no more ULDs
+//   unassigned, not newly over MTW, and CG closer to the target
+// - an engine gives different plans on two runs of the same flight
+// - an engine's p50 time, as a multiple of a reference timed in the same run (see ReferenceWork), or
+//   its arena peak grew past the allowed margin over the baseline
+// - replanDelta accepts a conflicting late change (a ULD removed more often than it is loaded,
+//   removed and re-weighed, or re-weighed twice), or changes the plan while rejecting it, or an
+//   accepted change leaves the plan's totals or occupancy out of step with its placements
+// - scoreCandidates gives a candidate in a SIMD lane a different weight, moment, score or MTW
+//   verdict, in any bit, than the same candidate scored alone by the scalar tail
+// The optimizer runs without a time budget here, so its plans depend only on the corpus.
+// How the optimizer compares with greedy is reported, not checked: the beam search doesn't promise
+// a better CG than first fit on every flight.
+struct FlightOutcome {
+    vector<string> slots; // per ULD, manifest order
+    double cg = 0.0, moment = 0.0, target = 0.0;
+    int unassigned = 0;
+    bool overMTW = false;
+};
+
+struct EngineRun {
+    string name;
+    PlanOptions opts;
+    BenchStats timing;
+    vector<double> referenceUs; // ReferenceWork samples, one per flight
+    size_t arenaPeakBytes = 0; // high-water mark of the flight arena, not process memory
+    vector<FlightOutcome> outcomes;
+    size_t nondeterministic = 0; // flights whose second plan differed from the first
+};
+
+FlightOutcome outcomeOf(const LoadPlan& plan, const PlanOptions& opts) {
+    FlightOutcome o;
+    for (auto& pl : plan.placements) o.slots.push_back(slotLabel(pl));
+    o.cg = planCG(plan);
+    o.moment = plan.totalMoment;
+    o.target = std::isnan(opts.targetCG) ? meanSlotArm(plan) : opts.targetCG;
+    o.unassigned = countUnassigned(plan);
+    o.overMTW = plan.tmpl->ac.mtw > 0 && plan.totalWeight > plan.tmpl->ac.mtw;
+    return o;
+}
+
+bool sameOutcome(const FlightOutcome& a, const FlightOutcome& b) {
+    return a.slots == b.slots && a.cg == b.cg && a.moment == b.moment;
+}
+
+// A plan that replaces the golden one must load at least as much, within MTW if the golden one was,
+// with CG closer to the target
+bool betterOutcome(const FlightOutcome& now, const FlightOutcome& golden) {
+    return now.unassigned <= golden.unassigned && (!now.overMTW || golden.overMTW) &&
+        fabs(now.cg - now.target) < fabs(golden.cg - now.target) - 1e-9;
+}
+
+json outcomeToJSON(const FlightOutcome& o) {
+    return { {"slots", o.slots}, {"cg", o.cg}, {"moment", o.moment}, {"unassigned", o.unassigned}, {"overMTW", o.overMTW} };
+}
+
+FlightOutcome outcomeFromJSON(const json& j) {
+    FlightOutcome o;
+    o.slots = j.at("slots").get<vector<string>>();
+    o.cg = j.at("cg").get<double>();
+    o.moment = j.at("moment").get<double>();
+    o.unassigned = j.at("unassigned").get<int>();
+    o.overMTW = j.at("overMTW").get<bool>();
+    return o;
+}
+
+vector<EngineRun> corpusEngines(const PlanOptions& base) {
+    vector<EngineRun> engines(3);
+    engines[0].name = "greedy";
+    engines[1].name = "lower-dp";
+    engines[2].name = "optimize";
+    for (auto& e : engines) e.opts = base;
+    engines[0].opts.engine = PlanEngine::GREEDY;
+    engines[1].opts.engine = PlanEngine::LOWER_DP;
+    engines[2].opts.engine = PlanEngine::OPTIMIZE;
+    engines[2].opts.timeBudgetMs = 0; // no wall-clock cut-off, so the golden plans don't depend on machine load
+    return engines;
+}
+
+double percentile(vector<double> v, size_t pct) {
+    if (v.empty()) return 0.0;
+    sort(v.begin(), v.end());
+    return v[min(v.size() - 1, v.size() * pct / 100)];
+}
+
+// Yardstick for the timing checks, code no planner change touches: sorting the same 512 doubles (branchy,
+// like the run searches) and a dependent chain of 1000 multiply-adds (bound by FP latency, like the
+// scoring). One sample is taken after each flight is planned, so both see the same clock speed and load,
+// and an engine's p50 is compared as a multiple of the reference p50: a baseline recorded on one machine
+// still holds on another of a similar kind.
+struct ReferenceWork {
+    vector<double> data, work;
+    double chain = 0.0;
+    ReferenceWork() : data(512) {
+        mt19937 rng(1);
+        for (auto& x : data) x = (double)rng();
+    }
+    void run() {
+        work = data;
+        sort(work.begin(), work.end());
+        double a = work[0];
+        for (int i = 0; i < 1000; ++i) a = a * 1.0000001 + 0.5;
+        chain += a; // kept, so the loop isn't optimized away
+    }
+    double sampleUs() {
+        run(); // warm-up: the planner may just have pushed the data out of cache
+        auto t0 = BenchClock::now();
+        run();
+        return elapsedUs(t0);
+    }
+};
+
+// Plan every flight twice with one engine, timing the first plan; each engine gets its own arena
+void runEngine(EngineRun& e, const vector<FlightManifest>& flights, map<string, Aircraft>& db, TemplateCache& templates,
+    const ULDDB& ulddb) {
+    FlightArena arena;
+    ReferenceWork reference;
+    for (auto& f : flights) {
+        auto tmpl = findTemplate(templates, db, f.model);
+        if (!tmpl) { e.outcomes.emplace_back(); continue; }
+        resetFlightArena(arena);
+        auto t0 = BenchClock::now();
+        LoadPlan plan = planFlight(tmpl, f.ulds, ulddb, e.opts, &arena);
+        e.timing.samplesUs.push_back(elapsedUs(t0));
+        e.referenceUs.push_back(reference.sampleUs());
+        e.outcomes.push_back(outcomeOf(plan, e.opts));
+        LoadPlan again = planFlight(tmpl, f.ulds, ulddb, e.opts);
+        if (!sameOutcome(e.outcomes.back(), outcomeOf(again, e.opts))) e.nondeterministic++;
+    }
+    e.arenaPeakBytes = arena.plan.peakBytes() + arena.scratch[0].peakBytes() + arena.scratch[1].peakBytes();
+}
+
+bool loadCorpus(const string& dir, vector<FlightManifest>& flights) {
+    flights.clear();
+    return streamManifest(dir + "/manifest.json", [&](FlightManifest&& f) { flights.push_back(std::move(f)); }) && !flights.empty();
+}
+
+// Totals and slot occupants agree with the placements
+bool planConsistent(const LoadPlan& plan) {
+    double weight = 0.0, moment = 0.0;
+    size_t occupied = 0;
+    for (size_t h = 0; h < plan.placements.size(); ++h) {
+        const Placement& pl = plan.placements[h];
+        if (pl.start < 0) continue;
+        const DeckSlots& deck = pl.onMain ? plan.mainSlots : plan.lowerSlots;
+        for (int w = pl.start; w < pl.start + pl.width; ++w) if (deck.occupant[w] != (int32_t)h) return false;
+        weight += plan.uldTable.ulds[h].weight;
+        moment += plan.uldTable.ulds[h].weight * runArm(deck, pl.start, pl.width);
+        occupied += pl.width;
+    }
+    size_t slotsTaken = 0;
+    for (const DeckSlots* deck : { &plan.mainSlots, &plan.lowerSlots })
+        for (int32_t o : deck->occupant) slotsTaken += o >= 0;
+    return slotsTaken == occupied && fabs(weight - plan.totalWeight) < 1e-6 && fabs(moment - plan.totalMoment) < 1e-6 * max(1.0, fabs(moment));
+}
+
+// Conflicting deltas on each flight's greedy plan, then one valid late change (last ULD offloaded,
+// another of the first one's type added); returns the flights where replanDelta misbehaved
+size_t checkDeltas(const vector<FlightManifest>& flights, map<string, Aircraft>& db, TemplateCache& templates,
+    const ULDDB& ulddb, vector<string>& failed) {
+    FlightArena arena;
+    PlanOptions greedy;
+    for (auto& f : flights) {
+        auto tmpl = findTemplate(templates, db, f.model);
+        if (!tmpl || f.ulds.empty()) continue;
+        resetFlightArena(arena);
+        LoadPlan plan = planFlight(tmpl, f.ulds, ulddb, greedy, &arena);
+        FlightOutcome before = outcomeOf(plan, greedy);
+        const string& id = f.ulds.back().id;
+        size_t copies = count_if(f.ulds.begin(), f.ulds.end(), [&](const ULD& u) { return u.id == id; });
+
+        vector<PlanDelta> conflicting(3);
+        conflicting[0].removed.assign(copies + 1, id);
+        conflicting[1].removed.push_back(id);
+        conflicting[1].reweighed.emplace_back(id, 100.0);
+        conflicting[2].reweighed = { {id, 100.0}, {id, 200.0} };
+        bool ok = true;
+        vector<PlanChange> changes;
+        for (auto& d : conflicting) {
+            ok = ok && !replanDelta(plan, d, ulddb, changes) && plan.placements.size() == f.ulds.size() &&
+                sameOutcome(outcomeOf(plan, greedy), before);
+        }
+
+        PlanDelta late;
+        late.removed.push_back(id);
+        late.added.push_back(f.ulds.front());
+        late.added.back().id += "L";
+        ok = ok && replanDelta(plan, late, ulddb, changes) && plan.placements.size() == f.ulds.size() && planConsistent(plan);
+        if (!ok) failed.push_back(f.flightId);
+    }
+    return failed.size();
+}
+
+// For each flight, every partial greedy plan (its first k placements) as a parent, placing ULD k at
+// every main and lower slot arm: scored in lanes together, then one at a time; returns the flights
+// where any candidate differed
+size_t checkKernelLanes(const vector<FlightManifest>& flights, map<string, Aircraft>& db, TemplateCache& templates,
+    const ULDDB& ulddb, vector<string>& failed) {
+    PlanOptions greedy;
+    CandidateScores lanes, single;
+    for (auto& f : flights) {
+        auto tmpl = findTemplate(templates, db, f.model);
+        if (!tmpl || f.ulds.empty()) continue;
+        LoadPlan plan = planFlight(tmpl, f.ulds, ulddb, greedy);
+        double target = meanSlotArm(plan);
+        double mtw = plan.tmpl->ac.mtw > 0 ? plan.tmpl->ac.mtw : INFINITY;
+        bool ok = true;
+        double weight = 0.0, moment = 0.0;
+        for (size_t k = 0; k < f.ulds.size() && ok; ++k) {
+            lanes.weight.clear(); lanes.moment.clear(); lanes.deviation.clear();
+            for (const DeckSlots* deck : { &plan.mainSlots, &plan.lowerSlots })
+                for (int s = 0; s < deck->layout->count; ++s) {
+                    lanes.weight.push_back(weight);
+                    lanes.moment.push_back(moment);
+                    lanes.deviation.push_back(runArm(*deck, s, 1));
+                }
+            single.weight.assign(lanes.weight.begin(), lanes.weight.end());
+            single.moment.assign(lanes.moment.begin(), lanes.moment.end());
+            single.deviation.assign(lanes.deviation.begin(), lanes.deviation.end());
+            scoreCandidates(lanes, f.ulds[k].weight, target, mtw);
+            for (size_t i = 0; i < single.weight.size() && ok; ++i) {
+                CandidateScores one;
+                one.weight.assign(1, single.weight[i]);
+                one.moment.assign(1, single.moment[i]);
+                one.deviation.assign(1, single.deviation[i]);
+                scoreCandidates(one, f.ulds[k].weight, target, mtw);
+                ok = memcmp(&one.weight[0], &lanes.weight[i], sizeof(double)) == 0 &&
+                    memcmp(&one.moment[0], &lanes.moment[i], sizeof(double)) == 0 &&
+                    memcmp(&one.deviation[0], &lanes.deviation[i], sizeof(double)) == 0 && one.fits[0] == lanes.fits[i];
+            }
+            const Placement& pl = plan.placements[k];
+            if (pl.start < 0) continue;
+            weight += f.ulds[k].weight;
+            moment += f.ulds[k].weight * runArm(pl.onMain ? plan.mainSlots : plan.lowerSlots, pl.start, pl.width);
+        }
+        if (!ok) failed.push_back(f.flightId);
+    }
+    return failed.size();
+}
+
+int recordCorpus(const string& dir, map<string, Aircraft>& db, const ULDDB& ulddb, int flightsPerAircraft, unsigned seed,
+    const PlanOptions& base) {
+    error_code ec;
+    filesystem::create_directories(dir, ec);
+    mt19937 rng(seed);
+    json manifest = json::array();
+    for (auto& kv : db) {
+        for (int i = 0; i < flightsPerAircraft; ++i) {
+            json ulds = json::array();
+            for (auto& u : makeSyntheticFlight(kv.second, ulddb, rng)) {
+                const char* type = u.type == ULD::Type::MAIN ? "MAIN" : u.type == ULD::Type::LOWER ? "LOWER" : "ANY";
+                ulds.push_back({ {"id", u.id}, {"weight", u.weight}, {"type", type}, {"allowSpecialSlots", u.allowSpecialSlots} });
+            }
+            manifest.push_back({ {"flight", kv.first + "-" + to_string(i + 1)}, {"model", kv.first}, {"ulds", ulds} });
+        }
+    }
+    ofstream(dir + "/manifest.json", ios::binary) << manifest.dump() << "\n";
+
+    // Plan what verify will read back, not the in-memory flights
+    vector<FlightManifest> flights;
+    if (!loadCorpus(dir, flights)) {
+        cout << RED << "Failed to write the corpus to " << dir << RESET << "\n";
+        return 1;
+    }
+    TemplateCache templates;
+    vector<EngineRun> engines = corpusEngines(base);
+    json baseline = { {"seed", seed}, {"flights", flights.size()}, {"engines", json::object()} };
+    for (auto& e : engines) {
+        runEngine(e, flights, db, templates, ulddb);
+        baseline["engines"][e.name] = { {"p50Us", percentile(e.timing.samplesUs, 50)},
+            {"p99Us", percentile(e.timing.samplesUs, 99)}, {"referenceUs", percentile(e.referenceUs, 50)},
+            {"arenaPeakBytes", e.arenaPeakBytes} };
+    }
+    ofstream golden(dir + "/golden.jsonl", ios::binary);
+    for (size_t i = 0; i < flights.size(); ++i) {
+        json line = { {"flight", flights[i].flightId} };
+        for (auto& e : engines) line[e.name] = outcomeToJSON(e.outcomes[i]);
+        golden << line.dump() << "\n";
+    }
+    ofstream(dir + "/baseline.json", ios::binary) << baseline.dump(2) << "\n";
+    cout << "Recorded " << flights.size() << " flights (" << db.size() << " aircraft, seed " << seed << ") to " << dir << "\n";
+    return 0;
+}
+
+int verifyCorpus(const string& dir, map<string, Aircraft>& db, const ULDDB& ulddb, const PlanOptions& base,
+    double maxSlowdownPct, double maxMemoryGrowthPct) {
+    vector<FlightManifest> flights;
+    json baseline;
+    vector<EngineRun> engines = corpusEngines(base);
+    vector<vector<FlightOutcome>> golden(engines.size()); // per engine, per flight
+    try {
+        if (!loadCorpus(dir, flights)) throw runtime_error("manifest.json");
+        ifstream b(dir + "/baseline.json");
+        b >> baseline;
+        ifstream g(dir + "/golden.jsonl");
+        for (string line; getline(g, line);) {
+            json j = json::parse(line);
+            for (size_t k = 0; k < engines.size(); ++k) golden[k].push_back(outcomeFromJSON(j.at(engines[k].name)));
+        }
+        if (golden[0].size() != flights.size()) throw runtime_error("golden.jsonl");
+    }
+    catch (...) {
+        cout << RED << dir << " is not a recorded corpus (run with --record first)" << RESET << "\n";
+        return 1;
+    }
+
+    TemplateCache templates;
+    for (auto& e : engines) runEngine(e, flights, db, templates, ulddb);
+
+    bool ok = true;
+    auto fail = [&](const string& what) { cout << RED << "FAIL " << what << RESET << "\n"; ok = false; };
+
+    // Against the golden plans: greedy must match exactly, the CG engines may only improve
+    vector<size_t> identical(engines.size()), improved(engines.size()), regressed(engines.size());
+    for (size_t k = 0; k < engines.size(); ++k) {
+        for (size_t i = 0; i < flights.size(); ++i) {
+            const FlightOutcome& now = engines[k].outcomes[i];
+            if (sameOutcome(now, golden[k][i])) { identical[k]++; continue; }
+            if (k > 0 && betterOutcome(now, golden[k][i])) { improved[k]++; continue; }
+            if (++regressed[k] <= 5) fail(engines[k].name + " plan for " + flights[i].flightId + " differs from the golden plan"
+                + (k > 0 ? " and isn't better" : ""));
+        }
+        if (regressed[k] > 5) fail(engines[k].name + ": " + to_string(regressed[k]) + " flights differ from the golden plans in all");
+    }
+
+    vector<string> deltaFailed;
+    if (checkDeltas(flights, db, templates, ulddb, deltaFailed)) {
+        for (size_t i = 0; i < min((size_t)5, deltaFailed.size()); ++i) fail("replanDelta misbehaved on " + deltaFailed[i]);
+        if (deltaFailed.size() > 5) fail(to_string(deltaFailed.size()) + " flights where replanDelta misbehaved in all");
+    }
+
+    vector<string> laneFailed;
+    if (checkKernelLanes(flights, db, templates, ulddb, laneFailed)) {
+        for (size_t i = 0; i < min((size_t)5, laneFailed.size()); ++i) fail("scoreCandidates lanes differ from the scalar tail on " + laneFailed[i]);
+        if (laneFailed.size() > 5) fail(to_string(laneFailed.size()) + " flights where scoreCandidates lanes differ in all");
+    }
+
+    // Optimizer against greedy, on flights both load fully within MTW
+    size_t better = 0, worse = 0, compared = 0;
+    for (size_t i = 0; i < flights.size(); ++i) {
+        const FlightOutcome& g = engines[0].outcomes[i];
+        const FlightOutcome& o = engines[2].outcomes[i];
+        if (g.slots.empty() || g.unassigned || g.overMTW || o.unassigned || o.overMTW) continue;
+        ++compared;
+        double dg = fabs(g.cg - g.target), dopt = fabs(o.cg - o.target);
+        if (dopt > dg + 1e-9) ++worse;
+        else if (dopt < dg - 1e-9) ++better;
+    }
+
+    cout << "=== LoadCalc regression corpus: " << flights.size() << " flights from " << dir << " ===\n";
+    // p50 in units of the reference (x ref): comparable across machines, unlike the microseconds
+    cout << left << setw(12) << "Engine" << right << setw(12) << "p50 (us)" << setw(12) << "p99 (us)" << setw(12) << "ref (us)"
+        << setw(12) << "p50 x ref" << setw(12) << "base x ref" << setw(14) << "arena peak" << setw(14) << "base peak"
+        << setw(10) << "nondet" << "\n";
+    cout << string(108, '-') << "\n";
+    for (auto& e : engines) {
+        double p50 = percentile(e.timing.samplesUs, 50);
+        json b = baseline["engines"].value(e.name, json::object());
+        double baseRef = b.value("referenceUs", 0.0);
+        double ref = percentile(e.referenceUs, 50);
+        double ratio = ref > 0 ? p50 / ref : 0.0;
+        double baseRatio = baseRef > 0 ? b.value("p50Us", 0.0) / baseRef : 0.0;
+        size_t basePeak = b.value("arenaPeakBytes", (size_t)0);
+        cout << left << setw(12) << e.name << right << fixed << setprecision(2) << setw(12) << p50
+            << setw(12) << percentile(e.timing.samplesUs, 99) << setw(12) << ref << setprecision(4) << setw(12) << ratio
+            << setw(12) << baseRatio << defaultfloat << setw(14) << e.arenaPeakBytes << setw(14) << basePeak
+            << setw(10) << e.nondeterministic << "\n";
+        if (e.nondeterministic) fail(e.name + ": " + to_string(e.nondeterministic) + " flights planned differently on a second run");
+        if (baseRatio > 0 && ratio > baseRatio * (1.0 + maxSlowdownPct / 100.0))
+            fail(e.name + ": p50 is " + formatFixed2(ratio / baseRatio * 100.0 - 100.0) + "% over the baseline, relative to the reference");
+        if (basePeak > 0 && e.arenaPeakBytes > basePeak * (1.0 + maxMemoryGrowthPct / 100.0))
+            fail(e.name + ": arena peak " + to_string(e.arenaPeakBytes) + " bytes is more than " + formatNumber(maxMemoryGrowthPct) + "% over the baseline");
+    }
+    for (size_t k = 0; k < engines.size(); ++k)
+        cout << engines[k].name << " vs golden: " << identical[k] << " identical, " << improved[k] << " better, "
+            << regressed[k] << " regressed\n";
+    cout << "replanDelta: " << (flights.size() - deltaFailed.size()) << "/" << flights.size() << " flights behaved\n";
+    cout << "scoreCandidates lanes vs scalar tail: " << (flights.size() - laneFailed.size()) << "/" << flights.size()
+        << " flights identical\n";
+    cout << "optimize vs greedy CG (" << compared << " fully loaded flights): " << better << " better, "
+        << (compared - better - worse) << " equal, " << worse << " worse\n";
+    cout << (ok ? "PASS" : RED + string("FAILED") + RESET) << "\n";
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    int flightsPerAircraft = 200, dbLoads = 20;
+    unsigned seed = 42;
+    PlanOptions opts;
+    string recordDir, verifyDir;
+    double maxSlowdownPct = 25.0, maxMemoryGrowthPct = 10.0;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        try {
+            if (arg == "--flights" && i + 1 < argc) flightsPerAircraft = stoi(argv[++i]);
+            else if (arg == "--db-loads" && i + 1 < argc) dbLoads = stoi(argv[++i]);
+            else if (arg == "--seed" && i + 1 < argc) seed = (unsigned)stoul(argv[++i]);
+            else if (arg == "--optimize") opts.engine = PlanEngine::OPTIMIZE;
+            else if (arg == "--lower-dp") opts.engine = PlanEngine::LOWER_DP;
+            else if (arg == "--budget-ms" && i + 1 < argc) opts.timeBudgetMs = stoi(argv[++i]);
+            else if (arg == "--record" && i + 1 < argc) recordDir = argv[++i];
+            else if (arg == "--verify" && i + 1 < argc) verifyDir = argv[++i];
+            else if (arg == "--max-slowdown" && i + 1 < argc) maxSlowdownPct = stod(argv[++i]);
+            else if (arg == "--max-memory-growth" && i + 1 < argc) maxMemoryGrowthPct = stod(argv[++i]);
+            else throw invalid_argument(arg);
+        }
+        catch (...) {
+            cout << "Usage: " << argv[0] << " [--flights <per aircraft>] [--db-loads <n>] [--seed <n>]\n"
+                << "       [--optimize [--budget-ms <ms>] | --lower-dp]\n"
+                << "       " << argv[0] << " --record <dir> [--flights <per aircraft>] [--seed <n>]\n"
+                << "       " << argv[0] << " --verify <dir> [--max-slowdown <pct>] [--max-memory-growth <pct>]\n";
+            return 1;
+        }
+    }
+
+    // DB loading
+    BenchStats jsonLoad{ "db load (json)" }, imageLoad{ "db load (image)" };
+    map<string, Aircraft> db;
+    ULDDB ulddb;
+    for (int i = 0; i < dbLoads; ++i) {
+        auto t0 = BenchClock::now();
+        db = loadAircraftDB(AIRCRAFT_DB_PATH);
+        ulddb = loadULDDB(ULD_DB_PATH);
+        jsonLoad.samplesUs.push_back(elapsedUs(t0));
+
+        map<string, Aircraft> imgDb;
+        ULDDB imgUld;
+        t0 = BenchClock::now();
+        if (loadDBImage(DB_IMAGE_PATH, AIRCRAFT_DB_PATH, ULD_DB_PATH, imgDb, imgUld))
+            imageLoad.samplesUs.push_back(elapsedUs(t0));
+    }
+    if (db.empty() || ulddb.entries.empty()) {
+        cout << RED << "aircraft_db.json and uld_db.json are required to run the benchmark." << RESET << "\n";
+        return 1;
+    }
+    if (!recordDir.empty()) return recordCorpus(recordDir, db, ulddb, flightsPerAircraft, seed, opts);
+    if (!verifyDir.empty()) return verifyCorpus(verifyDir, db, ulddb, opts, maxSlowdownPct, maxMemoryGrowthPct);
+
+    // Synthetic flights, generated up front so generation isn't timed; templates are built once
+    // per model as in batch and server mode
+    mt19937 rng(seed);
+    TemplateCache templates;
+    vector<pair<shared_ptr<const AircraftTemplate>, vector<ULD>>> flights;
+    for (auto& kv : db)
+        for (int i = 0; i < flightsPerAircraft; ++i)
+            flights.emplace_back(findTemplate(templates, db, kv.first), makeSyntheticFlight(kv.second, ulddb, rng));
+
+    const char* engineName = opts.engine == PlanEngine::OPTIMIZE ? "placement (optimize)"
+        : opts.engine == PlanEngine::LOWER_DP ? "placement (lower-dp)" : "placement (greedy)";
+    BenchStats widthLookup{ "getULDWidth" }, placement{ engineName };
+    BenchStats rendering{ "printDeckColumnsASCII" }, replan{ "replanDelta (+1/-1)" };
+    size_t checksum = 0; // keeps the optimizer from dropping the timed work
+    string renderBuf;
+    FlightArena arena; // reset per flight, as in batch and server mode
+
+    for (auto& f : flights) {
+        auto t0 = BenchClock::now();
+        for (auto& u : f.second) checksum += getULDWidth(ulddb, u.id);
+        if (!f.second.empty()) widthLookup.samplesUs.push_back(elapsedUs(t0) / f.second.size());
+
+        resetFlightArena(arena);
+        t0 = BenchClock::now();
+        LoadPlan plan = planFlight(f.first, f.second, ulddb, opts, &arena);
+        placement.samplesUs.push_back(elapsedUs(t0));
+        checksum += plan.report.size();
+
+        t0 = BenchClock::now();
+        printDeckColumnsASCII("Main", plan.tmpl->ac.mainDeck, plan.mainSlots, plan.uldTable.ulds, ulddb, renderBuf);
+        printDeckColumnsASCII("Lower", plan.tmpl->ac.lowerDeck, plan.lowerSlots, plan.uldTable.ulds, ulddb, renderBuf);
+        rendering.samplesUs.push_back(elapsedUs(t0));
+        checksum += renderBuf.size();
+        renderBuf.clear();
+
+        // a late ULD arrives (another of the first one's type) and the last one is offloaded
+        if (f.second.empty()) continue;
+        PlanDelta delta;
+        delta.added.push_back(f.second.front());
+        delta.added.back().id += "L";
+        delta.removed.push_back(f.second.back().id);
+        vector<PlanChange> changes;
+        t0 = BenchClock::now();
+        replanDelta(plan, delta, ulddb, changes);
+        replan.samplesUs.push_back(elapsedUs(t0));
+        checksum += changes.size();
+    }
+
+    cout << "=== LoadCalc benchmark: " << db.size() << " aircraft, " << flights.size() << " flights, seed " << seed << " ===\n";
+    cout << left << setw(22) << "Phase" << right << setw(23) << "Throughput" << setw(12) << "p50 (us)" << setw(12) << "p99 (us)"
+        << setw(10) << "Samples" << "\n";
+    cout << string(79, '-') << "\n";
+    printStats(jsonLoad, "loads");
+    if (imageLoad.samplesUs.empty()) cout << left << setw(22) << "db load (image)" << "skipped (run LoadCalc_CPP --compile-db)\n";
+    else printStats(imageLoad, "loads");
+    printStats(widthLookup, "lookups");
+    printStats(placement, "flights");
+    printStats(rendering, "flights");
+    printStats(replan, "flights");
+    cout << "(checksum " << checksum << ")\n";
+    return 0;
+}
@@ -9,6 +9,48 @@
 #include <fstream>
 #include <algorithm>
 #include <cctype>
+#include <unordered_map>
+#include <climits>
+#include <cstdint>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory_resource>
+#include <array>
+#include <list>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
@@ -17,6 +59,104 @@
 using json = nlohmann::json;
 using namespace std;
 
+// ===== Instrumentation =====
+// Optional per-phase timers and counters (--metrics json|prometheus). When disabled, each timer
+// or counter costs one branch. Phase times are inclusive: nested phases (e.g. run search inside
+// placement) are counted in both. candidate_filter is the screening of the runs each ULD could take
+// (the optimizer's successors, the lower-deck DP's start table); the greedy engines have no separate
+// screening step, their search is run_search.
+enum class Phase { DB_LOAD_AIRCRAFT, DB_LOAD_ULD, DB_LOAD_IMAGE, TEMPLATE_BUILD, PLACEMENT,
+    CANDIDATE_FILTER, RUN_SEARCH, RENDER, SAVE, COUNT };
+const char* const PHASE_NAMES[] = { "db_load_aircraft", "db_load_uld", "db_load_image", "template_build",
+    "placement", "candidate_filter", "run_search", "render", "save" };
+
+// Rejections are counted per deck that couldn't take a ULD, so one ULD can be rejected twice.
+// reject_mtw is counted once per ULD the optimizer leaves out because every placement it had
+// would have gone over MTW.
+enum class Counter { FLIGHTS, PLACEMENT_ATTEMPTS, REJECT_DECK_MISMATCH, REJECT_NOSE_TAIL, REJECT_NO_RUN,
+    REJECT_MTW, UNASSIGNED, PLAN_CACHE_HITS, PLAN_CACHE_MISSES, FIXED_PATH_HITS, FIXED_PATH_MISSES, COUNT };
+const char* const COUNTER_NAMES[] = { "flights", "placement_attempts", "reject_deck_mismatch",
+    "reject_nose_tail", "reject_no_run", "reject_mtw", "unassigned", "plan_cache_hits", "plan_cache_misses",
+    "fixed_path_hits", "fixed_path_misses" };
+
+enum class MetricsFormat { JSON, PROMETHEUS };
+
+struct Metrics {
+    bool enabled = false; // set once at startup, before any worker threads
+    MetricsFormat format = MetricsFormat::JSON;
+    atomic<uint64_t> phaseNs[(int)Phase::COUNT] = {};
+    atomic<uint64_t> phaseCalls[(int)Phase::COUNT] = {};
+    atomic<uint64_t> counters[(int)Counter::COUNT] = {};
+};
+Metrics g_metrics;
+
+struct ScopedTimer {
+    explicit ScopedTimer(Phase p) : phase(p), on(g_metrics.enabled) {
+        if (on) t0 = chrono::steady_clock::now();
+    }
+    ~ScopedTimer() { stop(); }
+    // end the phase before the scope does
+    void stop() {
+        if (!on) return;
+        on = false;
+        auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count();
+        g_metrics.phaseNs[(int)phase].fetch_add((uint64_t)ns, memory_order_relaxed);
+        g_metrics.phaseCalls[(int)phase].fetch_add(1, memory_order_relaxed);
+    }
+    Phase phase;
+    bool on;
+    chrono::steady_clock::time_point t0;
+};
+
+inline void countEvent(Counter c, uint64_t n = 1) {
+    if (g_metrics.enabled) g_metrics.counters[(int)c].fetch_add(n, memory_order_relaxed);
+}
+
+json metricsJSON() {
+    json phases = json::object(), counters = json::object();
+    for (int i = 0; i < (int)Phase::COUNT; ++i)
+        phases[PHASE_NAMES[i]] = { {"calls", g_metrics.phaseCalls[i].load()}, {"seconds", g_metrics.phaseNs[i].load() / 1e9} };
+    for (int i = 0; i < (int)Counter::COUNT; ++i) counters[COUNTER_NAMES[i]] = g_metrics.counters[i].load();
+    return { {"phases", phases}, {"counters", counters} };
+}
+
+// Prometheus text exposition format
+string metricsPrometheus() {
+    ostringstream out;
+    out << "# HELP loadcalc_phase_seconds_total Time spent in each planner phase.\n"
+        << "# TYPE loadcalc_phase_seconds_total counter\n";
+    for (int i = 0; i < (int)Phase::COUNT; ++i)
+        out << "loadcalc_phase_seconds_total{phase=\"" << PHASE_NAMES[i] << "\"} " << g_metrics.phaseNs[i].load() / 1e9 << "\n";
+    out << "# HELP loadcalc_phase_calls_total Times each planner phase ran.\n"
+        << "# TYPE loadcalc_phase_calls_total counter\n";
+    for (int i = 0; i < (int)Phase::COUNT; ++i)
+        out << "loadcalc_phase_calls_total{phase=\"" << PHASE_NAMES[i] << "\"} " << g_metrics.phaseCalls[i].load() << "\n";
+    for (int i = 0; i < (int)Counter::COUNT; ++i) {
+        out << "# TYPE loadcalc_" << COUNTER_NAMES[i] << "_total counter\n"
+            << "loadcalc_" << COUNTER_NAMES[i] << "_total " << g_metrics.counters[i].load() << "\n";
+    }
+    return out.str();
+}
+
+string metricsReport() {
+    return g_metrics.format == MetricsFormat::PROMETHEUS ? metricsPrometheus() : metricsJSON().dump(2) + "\n";
+}
+
+bool parseMetricsFormat(const string& s, MetricsFormat& format) {
+    if (s == "json") format = MetricsFormat::JSON;
+    else if (s == "prometheus" || s == "prom") format = MetricsFormat::PROMETHEUS;
+    else return false;
+    return true;
+}
+
+// End-of-run report: to `path`, or stderr so it doesn't mix with results on stdout
+void writeMetrics(const string& path) {
+    string report = metricsReport();
+    if (path.empty()) { cerr << report; return; }
+    ofstream out(path, ios::binary);
+    out << report;
+}
+
 // ===== Structs =====
 struct Deck {
     int slots = 0;
@@ -41,6 +181,13 @@ struct ULDDBEntry {
     string notes = "";
 };
 
+// ULD DB with a prefix index built at load time, so lookups don't rescan every entry
+struct ULDDB {
+    vector<ULDDBEntry> entries;
+    unordered_map<string, int> byPrefix; // prefix -> first entry with that prefix
+    vector<size_t> prefixLengths;        // distinct prefix lengths (all 3 for IATA codes)
+};
+
 struct ULD {
     string id = "";
     double weight = 0.0;
@@ -48,18 +195,78 @@ struct ULD {
     bool allowSpecialSlots = true;
 };
 
-enum class SlotType { NORMAL, NOSE, TAIL };
+// ULDs of one flight. A ULD's handle is its index in `ulds`, stable for the life of the plan (a
+// delta that removes ULDs renumbers the rest once, see compactULDs); byId maps an ID to its first handle (IDs can repeat in real manifests, handles can't).
+struct ULDTable {
+    explicit ULDTable(std::pmr::memory_resource* mr = std::pmr::get_default_resource()) : ulds(mr), byId(mr) {}
+    std::pmr::vector<ULD> ulds;
+    std::pmr::unordered_map<string, int32_t> byId;
+};
+
+void fillULDTable(ULDTable& t, const vector<ULD>& ulds) {
+    t.ulds.assign(ulds.begin(), ulds.end());
+    t.byId.clear();
+    t.byId.reserve(ulds.size());
+    for (int32_t h = 0; h < (int32_t)ulds.size(); ++h) t.byId.emplace(ulds[h].id, h);
+}
+
+// Handle of the first ULD with this ID, -1 if none
+int32_t findULD(const ULDTable& t, const string& id) {
+    auto it = t.byId.find(id);
+    return it == t.byId.end() ? -1 : it->second;
+}
+
+enum class SlotType : uint8_t { NORMAL, NOSE, TAIL };
+enum class DeckId : uint8_t { MAIN, LOWER };
+
+// One printed row of the ASCII deck plan: its slots and the parts of its text that don't depend
+// on the load, each a whole line of fixed width
+struct DeckRenderRow {
+    int first = 0, count = 0;
+    string emptyContent; // ID line with no occupants (nose / tail markers only)
+    string numbers;      // slot number line
+    string blank;        // empty cells, for the weight line
+    string border;       // bottom border
+};
+
+// Fixed geometry of one deck, indexed by slot number - 1. Built once per aircraft model
+// (see AircraftTemplate) and shared read-only by every flight planned on it.
+struct DeckLayout {
+    DeckId deck = DeckId::MAIN;
+    int count = 0;
+    vector<double> arm;
+    vector<SlotType> slotType;
+    vector<uint64_t> valid;                // bit set = slot exists, 64 slots per word
+    vector<uint64_t> special;              // bit set = NOSE/TAIL slot
+    vector<vector<uint64_t>> runStarts[2]; // [allowSpecialSlots][width]: bit set = a run of width slots may start here
+    vector<vector<int>> feasibleStarts[2]; // [allowSpecialSlots][width]: the same starts as a list, ascending
+    vector<vector<double>> runArm;         // [width][start]: mean arm of the run of width slots from start
+    vector<DeckRenderRow> renderRows;      // ASCII deck plan rows: 1 slot, then 3 per row, then 1
+    size_t renderBytes = 0;                // upper bound on one rendered deck plan
+};
 
-struct Slot {
-    string deckName;
-    int index = 0;
-    double arm = 0.0;
-    bool occupied = false;
-    string occupantId = "";
-    double occupantWeight = 0.0;
-    SlotType slotType = SlotType::NORMAL;
+// Per-flight occupancy of one deck as parallel arrays (struct-of-arrays); geometry is in the layout
+struct DeckSlots {
+    explicit DeckSlots(std::pmr::memory_resource* mr = std::pmr::get_default_resource()) : occupantWeight(mr), occupant(mr) {}
+    const DeckLayout* layout = nullptr;
+    std::pmr::vector<double> occupantWeight; // share of the occupant's weight on this slot
+    std::pmr::vector<int32_t> occupant;      // handle (index into the planned ULD list), -1 = empty
 };
 
+const char* deckName(DeckId d) { return d == DeckId::MAIN ? "main" : "lower"; }
+
+double deckWeight(const DeckSlots& d) {
+    double w = 0.0;
+    for (double v : d.occupantWeight) w += v;
+    return w;
+}
+
+double deckMoment(const DeckSlots& d) {
+    double m = 0.0;
+    for (size_t i = 0; i < d.occupantWeight.size(); ++i) m += d.occupantWeight[i] * d.layout->arm[i];
+    return m;
+}
+
 // ANSI color codes
 const string RESET = "\033[0m";
 const string RED = "\033[31m";
@@ -78,8 +285,20 @@ map<string, string> uldTypeColors = {
     {"LD39", BOLD + YELLOW}, {"M1", CYAN}, {"M1H", BLUE}, {"M6", MAGENTA}
 };
 
-vector<ULDDBEntry> loadULDDB(const string& path) {
-    vector<ULDDBEntry> db;
+void indexULDDB(ULDDB& db) {
+    db.byPrefix.clear();
+    db.prefixLengths.clear();
+    for (int i = 0; i < (int)db.entries.size(); ++i) {
+        const string& prefix = db.entries[i].prefix;
+        db.byPrefix.emplace(prefix, i); // keeps the first entry, same as a front-to-back scan
+        if (find(db.prefixLengths.begin(), db.prefixLengths.end(), prefix.size()) == db.prefixLengths.end())
+            db.prefixLengths.push_back(prefix.size());
+    }
+}
+
+ULDDB loadULDDB(const string& path) {
+    ScopedTimer timer(Phase::DB_LOAD_ULD);
+    ULDDB db;
     ifstream in(path);
     if (!in) return db;
 
@@ -95,17 +314,27 @@ vector<ULDDBEntry> loadULDDB(const string& path) {
         e.widthSlots = entry.value("Width (slots)", 1);
         e.deck = entry.value("Deck", "Any");
         e.notes = entry.value("Notes", "");
-        db.push_back(e);
+        db.entries.push_back(e);
     }
+    indexULDDB(db);
     return db;
 }
 
-// Helper to find widthSlots by ULD ID prefix
-int getULDWidth(const vector<ULDDBEntry>& db, const string& uldId) {
-    for (auto& e : db) {
-        if (uldId.rfind(e.prefix, 0) == 0) return e.widthSlots; // prefix matches start of ULD ID
+// Find the DB entry whose prefix matches the start of the ULD ID (first in file order wins)
+const ULDDBEntry* findULDEntry(const ULDDB& db, const string& uldId) {
+    int best = INT_MAX;
+    for (size_t len : db.prefixLengths) {
+        if (len > uldId.size()) continue;
+        auto it = db.byPrefix.find(uldId.substr(0, len));
+        if (it != db.byPrefix.end() && it->second < best) best = it->second;
     }
-    return 1; // default 1 slot
+    return best == INT_MAX ? nullptr : &db.entries[best];
+}
+
+// Helper to find widthSlots by ULD ID prefix
+int getULDWidth(const ULDDB& db, const string& uldId) {
+    const ULDDBEntry* e = findULDEntry(db, uldId);
+    return e ? e->widthSlots : 1; // default 1 slot
 }
 
 vector<double> generateDefaultArms(int n, double foreArm = 10.0, double aftArm = 40.0) {
@@ -119,7 +348,35 @@ vector<double> generateDefaultArms(int n, double foreArm = 10.0, double aftArm =
     return arms;
 }
 
+Aircraft parseAircraftEntry(const json& entry) {
+    Aircraft a;
+    a.model = entry.value("model", "");
+    a.mtw = entry.value("mtw", 0);
+
+    if (entry.contains("mainDeck")) {
+        auto& m = entry["mainDeck"];
+        a.mainDeck.slots = m.value("slots", 0);
+        a.mainDeck.rowLength = m.value("rowLength", 8);
+        a.mainDeck.noseSlots = m.value("noseSlots", 0);
+        a.mainDeck.tailSlots = m.value("tailSlots", 0);
+        if (m.contains("slotArms") && m["slotArms"].is_array())
+            for (auto& v : m["slotArms"]) a.mainDeck.slotArms.push_back((double)v);
+    }
+
+    if (entry.contains("lowerDeck")) {
+        auto& l = entry["lowerDeck"];
+        a.lowerDeck.slots = l.value("slots", 0);
+        a.lowerDeck.rowLength = l.value("rowLength", 8);
+        a.lowerDeck.noseSlots = l.value("noseSlots", 0);
+        a.lowerDeck.tailSlots = l.value("tailSlots", 0);
+        if (l.contains("slotArms") && l["slotArms"].is_array())
+            for (auto& v : l["slotArms"]) a.lowerDeck.slotArms.push_back((double)v);
+    }
+    return a;
+}
+
 map<string, Aircraft> loadAircraftDB(const string& path) {
+    ScopedTimer timer(Phase::DB_LOAD_AIRCRAFT);
     map<string, Aircraft> db;
     ifstream in(path);
     if (!in) return db;
@@ -129,33 +386,351 @@ map<string, Aircraft> loadAircraftDB(const string& path) {
     if (!j.is_array()) return db;
 
     for (auto& entry : j) {
-        Aircraft a;
-        a.model = entry.value("model", "");
-        a.mtw = entry.value("mtw", 0);
+        Aircraft a = parseAircraftEntry(entry);
+        if (!a.model.empty()) db[a.model] = a;
+    }
+    return db;
+}
 
-        if (entry.contains("mainDeck")) {
-            auto& m = entry["mainDeck"];
-            a.mainDeck.slots = m.value("slots", 0);
-            a.mainDeck.rowLength = m.value("rowLength", 8);
-            a.mainDeck.noseSlots = m.value("noseSlots", 0);
-            a.mainDeck.tailSlots = m.value("tailSlots", 0);
-            if (m.contains("slotArms") && m["slotArms"].is_array())
-                for (auto& v : m["slotArms"]) a.mainDeck.slotArms.push_back((double)v);
-        }
+// ===== Lazy aircraft DB =====
+// Batch, server and interactive mode look aircraft up by model through an AircraftDB. Loaded eagerly,
+// every entry is parsed up front; loaded lazily (--lazy-db), startup only scans the file for the byte
+// range and model of each entry, and an entry is parsed the first time its model is requested and
+// kept for later lookups. Lookups are not synchronised: each mode owns its AircraftDB on one thread.
+struct AircraftDB {
+    map<string, Aircraft> parsed;
+    string path;                                // lazy mode: indexed file
+    map<string, pair<size_t, size_t>> offsets;  // lazy mode: model -> [begin, end) of its JSON object
+};
+
+// Record the byte range of each object in the top-level array and the "model" string inside it.
+// Only brackets and strings are tracked, so a malformed entry is reported when it is first parsed.
+bool indexAircraftDB(const string& path, AircraftDB& db) {
+    ScopedTimer timer(Phase::DB_LOAD_AIRCRAFT);
+    db.parsed.clear();
+    db.offsets.clear();
+    db.path = path;
+    ifstream in(path, ios::binary);
+    if (!in) return false;
+    string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
 
-        if (entry.contains("lowerDeck")) {
-            auto& l = entry["lowerDeck"];
-            a.lowerDeck.slots = l.value("slots", 0);
-            a.lowerDeck.rowLength = l.value("rowLength", 8);
-            a.lowerDeck.noseSlots = l.value("noseSlots", 0);
-            a.lowerDeck.tailSlots = l.value("tailSlots", 0);
-            if (l.contains("slotArms") && l["slotArms"].is_array())
-                for (auto& v : l["slotArms"]) a.lowerDeck.slotArms.push_back((double)v);
+    size_t first = text.find_first_not_of(" \t\r\n");
+    if (first == string::npos || text[first] != '[') return false;
+    int depth = 0;
+    size_t entryBegin = 0;
+    string model;
+    bool modelNext = false; // the last top-level key of the current entry was "model"
+    for (size_t i = first; i < text.size(); ++i) {
+        char c = text[i];
+        if (c == '"') {
+            size_t end = i + 1;
+            while (end < text.size() && text[end] != '"') end += text[end] == '\\' ? 2 : 1;
+            if (end >= text.size()) return false;
+            if (depth == 2) {
+                size_t next = text.find_first_not_of(" \t\r\n", end + 1);
+                bool isKey = next != string::npos && text[next] == ':';
+                if (isKey) modelNext = text.compare(i, end + 1 - i, "\"model\"") == 0;
+                else if (modelNext) {
+                    try { model = json::parse(text.begin() + i, text.begin() + end + 1).get<string>(); }
+                    catch (...) { model.clear(); }
+                    modelNext = false;
+                }
+            }
+            i = end;
+        }
+        else if (c == '{' || c == '[') {
+            if (++depth == 2 && c == '{') { entryBegin = i; model.clear(); modelNext = false; }
         }
+        else if (c == '}' || c == ']') {
+            if (depth == 2 && c == '}' && !model.empty()) db.offsets[model] = { entryBegin, i + 1 };
+            if (--depth == 0) return true;
+        }
+    }
+    return false;
+}
+
+size_t aircraftCount(const AircraftDB& db) {
+    return db.path.empty() ? db.parsed.size() : db.offsets.size();
+}
+
+vector<string> aircraftModels(const AircraftDB& db) {
+    vector<string> models;
+    if (db.path.empty()) for (auto& kv : db.parsed) models.push_back(kv.first);
+    else for (auto& kv : db.offsets) models.push_back(kv.first);
+    return models;
+}
+
+// nullptr if the model is unknown or (lazy mode) its entry can't be read or parsed
+const Aircraft* findAircraft(AircraftDB& db, const string& model) {
+    auto it = db.parsed.find(model);
+    if (it != db.parsed.end()) return &it->second;
+    auto off = db.offsets.find(model);
+    if (off == db.offsets.end()) return nullptr;
+
+    ScopedTimer timer(Phase::DB_LOAD_AIRCRAFT);
+    ifstream in(db.path, ios::binary);
+    string text(off->second.second - off->second.first, '\0');
+    if (!in.seekg((streamoff)off->second.first) || !in.read(&text[0], (streamsize)text.size())) return nullptr;
+    Aircraft a;
+    try { a = parseAircraftEntry(json::parse(text)); }
+    catch (...) { return nullptr; }
+    if (a.model != model) return nullptr; // file changed since it was indexed
+    return &db.parsed.emplace(model, move(a)).first->second;
+}
+
+// ===== Binary DB image =====
+// `--compile-db` turns aircraft_db.json and uld_db.json into one flat, versioned image that is
+// memory-mapped at startup instead of parsed. All references are offsets into the image, every
+// record is fixed size and naturally aligned, and the header holds a hash of each JSON source so a
+// stale image (JSON edited since compiling) is ignored in favour of the JSON files.
+// Layout: header | aircraft records | ULD records | slot arms (double) | string bytes
+const char* const DB_IMAGE_MAGIC = "LCDB";
+const uint32_t DB_IMAGE_VERSION = 1;
+
+struct DBImageHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t aircraftSourceHash;
+    uint64_t uldSourceHash;
+    uint32_t aircraftCount, uldCount, armCount, stringBytes;
+    uint64_t aircraftOffset, uldOffset, armOffset, stringOffset;
+};
+
+struct DBImageDeck {
+    int32_t slots, rowLength, noseSlots, tailSlots;
+    uint32_t armIndex, armCount;
+};
+
+struct DBImageAircraft {
+    uint32_t modelOffset, modelLength;
+    int32_t mtw;
+    uint32_t reserved;
+    DBImageDeck mainDeck, lowerDeck;
+};
+
+struct DBImageULD {
+    uint32_t prefixOffset, prefixLength;
+    uint32_t typeOffset, typeLength;
+    uint32_t deckOffset, deckLength;
+    uint32_t notesOffset, notesLength;
+    int32_t widthSlots;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(DBImageHeader) == 72 && sizeof(DBImageDeck) == 24 &&
+    sizeof(DBImageAircraft) == 64 && sizeof(DBImageULD) == 40, "DB image records must not be padded");
+
+// Read-only memory mapping of a whole file, unmapped on destruction
+struct MappedFile;
+void unmapFile(MappedFile& m);
+
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { unmapFile(*this); }
+};
+
+void unmapFile(MappedFile& m) {
+#ifdef _WIN32
+    if (m.data) UnmapViewOfFile(m.data);
+    if (m.mapping) CloseHandle(m.mapping);
+    if (m.file != INVALID_HANDLE_VALUE) CloseHandle(m.file);
+    m.file = INVALID_HANDLE_VALUE; m.mapping = nullptr;
+#else
+    if (m.data) munmap((void*)m.data, m.size);
+    if (m.fd >= 0) close(m.fd);
+    m.fd = -1;
+#endif
+    m.data = nullptr; m.size = 0;
+}
+
+bool mapFile(const string& path, MappedFile& m) {
+    unmapFile(m);
+#ifdef _WIN32
+    m.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m.file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m.file, &size) || size.QuadPart == 0) { unmapFile(m); return false; }
+    m.mapping = CreateFileMappingA(m.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m.mapping) { unmapFile(m); return false; }
+    m.data = (const char*)MapViewOfFile(m.mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m.data) { unmapFile(m); return false; }
+    m.size = (size_t)size.QuadPart;
+#else
+    m.fd = open(path.c_str(), O_RDONLY);
+    if (m.fd < 0) return false;
+    struct stat st;
+    if (fstat(m.fd, &st) != 0 || st.st_size == 0) { unmapFile(m); return false; }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, m.fd, 0);
+    if (p == MAP_FAILED) { unmapFile(m); return false; }
+    m.data = (const char*)p;
+    m.size = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+// FNV-1a, continuing from h
+uint64_t hashBytes(const char* data, size_t n, uint64_t h = 14695981039346656037ull) {
+    for (size_t i = 0; i < n; ++i) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+// FNV-1a over the raw file bytes (0 if the file can't be read)
+uint64_t hashFile(const string& path) {
+    ifstream in(path, ios::binary);
+    if (!in) return 0;
+    uint64_t h = hashBytes(nullptr, 0);
+    char buf[1 << 16];
+    while (in.read(buf, sizeof(buf)), in.gcount() > 0) h = hashBytes(buf, (size_t)in.gcount(), h);
+    return h;
+}
+
+bool compileDBImage(const string& aircraftPath, const string& uldPath, const string& imagePath) {
+    auto db = loadAircraftDB(aircraftPath);
+    auto ulddb = loadULDDB(uldPath);
+    if (db.empty() && ulddb.entries.empty()) return false;
+
+    vector<DBImageAircraft> aircraft;
+    vector<DBImageULD> ulds;
+    vector<double> arms;
+    string strings;
+    auto addString = [&](const string& str, uint32_t& off, uint32_t& len) {
+        off = (uint32_t)strings.size(); len = (uint32_t)str.size();
+        strings += str;
+    };
+    auto addDeck = [&](const Deck& d) {
+        DBImageDeck rec{ d.slots, d.rowLength, d.noseSlots, d.tailSlots, (uint32_t)arms.size(), (uint32_t)d.slotArms.size() };
+        arms.insert(arms.end(), d.slotArms.begin(), d.slotArms.end());
+        return rec;
+    };
+
+    for (auto& kv : db) {
+        DBImageAircraft rec{};
+        addString(kv.second.model, rec.modelOffset, rec.modelLength);
+        rec.mtw = kv.second.mtw;
+        rec.mainDeck = addDeck(kv.second.mainDeck);
+        rec.lowerDeck = addDeck(kv.second.lowerDeck);
+        aircraft.push_back(rec);
+    }
+    for (auto& e : ulddb.entries) {
+        DBImageULD rec{};
+        addString(e.prefix, rec.prefixOffset, rec.prefixLength);
+        addString(e.uldType, rec.typeOffset, rec.typeLength);
+        addString(e.deck, rec.deckOffset, rec.deckLength);
+        addString(e.notes, rec.notesOffset, rec.notesLength);
+        rec.widthSlots = e.widthSlots;
+        ulds.push_back(rec);
+    }
+
+    DBImageHeader h{};
+    memcpy(h.magic, DB_IMAGE_MAGIC, 4);
+    h.version = DB_IMAGE_VERSION;
+    h.aircraftSourceHash = hashFile(aircraftPath);
+    h.uldSourceHash = hashFile(uldPath);
+    h.aircraftCount = (uint32_t)aircraft.size();
+    h.uldCount = (uint32_t)ulds.size();
+    h.armCount = (uint32_t)arms.size();
+    h.stringBytes = (uint32_t)strings.size();
+    h.aircraftOffset = sizeof(DBImageHeader);
+    h.uldOffset = h.aircraftOffset + aircraft.size() * sizeof(DBImageAircraft);
+    h.armOffset = h.uldOffset + ulds.size() * sizeof(DBImageULD);
+    h.stringOffset = h.armOffset + arms.size() * sizeof(double);
+
+    ofstream out(imagePath, ios::binary | ios::trunc);
+    if (!out) return false;
+    out.write((const char*)&h, sizeof(h));
+    out.write((const char*)aircraft.data(), aircraft.size() * sizeof(DBImageAircraft));
+    out.write((const char*)ulds.data(), ulds.size() * sizeof(DBImageULD));
+    out.write((const char*)arms.data(), arms.size() * sizeof(double));
+    out.write(strings.data(), strings.size());
+    return (bool)out;
+}
+
+// Load both databases from the image if it is current, false if missing, corrupt or stale
+bool loadDBImage(const string& imagePath, const string& aircraftPath, const string& uldPath,
+    map<string, Aircraft>& db, ULDDB& ulddb) {
+    ScopedTimer timer(Phase::DB_LOAD_IMAGE);
+    MappedFile m;
+    if (!mapFile(imagePath, m) || m.size < sizeof(DBImageHeader)) return false;
+
+    const DBImageHeader& h = *(const DBImageHeader*)m.data;
+    if (memcmp(h.magic, DB_IMAGE_MAGIC, 4) != 0 || h.version != DB_IMAGE_VERSION) return false;
+    if (h.stringOffset + h.stringBytes != m.size ||
+        h.uldOffset != h.aircraftOffset + (uint64_t)h.aircraftCount * sizeof(DBImageAircraft) ||
+        h.armOffset != h.uldOffset + (uint64_t)h.uldCount * sizeof(DBImageULD) ||
+        h.stringOffset != h.armOffset + (uint64_t)h.armCount * sizeof(double)) return false;
+    if (h.aircraftSourceHash != hashFile(aircraftPath) || h.uldSourceHash != hashFile(uldPath)) return false;
+
+    const auto* aircraft = (const DBImageAircraft*)(m.data + h.aircraftOffset);
+    const auto* ulds = (const DBImageULD*)(m.data + h.uldOffset);
+    const auto* arms = (const double*)(m.data + h.armOffset);
+    const char* strings = m.data + h.stringOffset;
+    auto str = [&](uint32_t off, uint32_t len) {
+        return off + (uint64_t)len <= h.stringBytes ? string(strings + off, len) : string();
+    };
+    auto deck = [&](const DBImageDeck& rec, Deck& d) {
+        d.slots = rec.slots; d.rowLength = rec.rowLength;
+        d.noseSlots = rec.noseSlots; d.tailSlots = rec.tailSlots;
+        if (rec.armIndex + (uint64_t)rec.armCount <= h.armCount)
+            d.slotArms.assign(arms + rec.armIndex, arms + rec.armIndex + rec.armCount);
+    };
 
+    db.clear();
+    for (uint32_t i = 0; i < h.aircraftCount; ++i) {
+        Aircraft a;
+        a.model = str(aircraft[i].modelOffset, aircraft[i].modelLength);
+        a.mtw = aircraft[i].mtw;
+        deck(aircraft[i].mainDeck, a.mainDeck);
+        deck(aircraft[i].lowerDeck, a.lowerDeck);
         if (!a.model.empty()) db[a.model] = a;
     }
-    return db;
+
+    ulddb = ULDDB();
+    ulddb.entries.reserve(h.uldCount);
+    for (uint32_t i = 0; i < h.uldCount; ++i) {
+        ULDDBEntry e;
+        e.prefix = str(ulds[i].prefixOffset, ulds[i].prefixLength);
+        e.uldType = str(ulds[i].typeOffset, ulds[i].typeLength);
+        e.deck = str(ulds[i].deckOffset, ulds[i].deckLength);
+        e.notes = str(ulds[i].notesOffset, ulds[i].notesLength);
+        e.widthSlots = ulds[i].widthSlots;
+        ulddb.entries.push_back(e);
+    }
+    indexULDDB(ulddb);
+    return true;
+}
+
+const char* const AIRCRAFT_DB_PATH = "aircraft_db.json";
+const char* const ULD_DB_PATH = "uld_db.json";
+const char* const DB_IMAGE_PATH = "loadcalc_db.bin";
+
+// Use the compiled image when it matches the JSON sources, otherwise parse the JSON
+void loadDatabases(map<string, Aircraft>& db, ULDDB& ulddb) {
+    if (loadDBImage(DB_IMAGE_PATH, AIRCRAFT_DB_PATH, ULD_DB_PATH, db, ulddb)) return;
+    ulddb = loadULDDB(ULD_DB_PATH);
+    db = loadAircraftDB(AIRCRAFT_DB_PATH);
+}
+
+// Lazy mode indexes aircraft_db.json and skips the compiled image, which holds every entry parsed
+void loadDatabases(AircraftDB& db, ULDDB& ulddb, bool lazy) {
+    if (!lazy) {
+        db = AircraftDB{};
+        loadDatabases(db.parsed, ulddb);
+        return;
+    }
+    ulddb = loadULDDB(ULD_DB_PATH);
+    indexAircraftDB(AIRCRAFT_DB_PATH, db);
 }
 
 // ===== Utility =====
@@ -179,113 +754,245 @@ int promptInt(const string& msg) {
     }
 }
 
-bool saveLoadPlanToFile(const string& filename, const vector<string>& lines) {
-    ofstream out(filename);
-    if (!out.is_open()) return false;
-    for (const auto& line : lines) out << line << "\n";
+// ===== Work-stealing pool =====
+// Runs fn(i) for every i in [0, n) on `threads` threads (0 = one per core). Each worker starts
+// with its own contiguous block of indices and works through it front to back; a worker that
+// runs dry steals the back half of another worker's remaining block, so a few expensive jobs
+// don't leave the rest of the pool idle. fn must be safe to call concurrently.
+template <typename Fn>
+void parallelFor(size_t n, unsigned threads, Fn fn) {
+    if (n == 0) return;
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    threads = (unsigned)min<size_t>(threads, n);
+
+    struct Block {
+        mutex m;
+        size_t next = 0, end = 0;
+    };
+    vector<Block> blocks(threads);
+    for (unsigned t = 0; t < threads; ++t) {
+        blocks[t].next = n * t / threads;
+        blocks[t].end = n * (t + 1) / threads;
+    }
+
+    auto worker = [&](unsigned self) {
+        Block& own = blocks[self];
+        while (true) {
+            size_t i = n;
+            {
+                lock_guard<mutex> lock(own.m);
+                if (own.next < own.end) i = own.next++;
+            }
+            if (i < n) { fn(i); continue; }
+
+            size_t lo = 0, hi = 0;
+            for (unsigned k = 1; k < threads && lo == hi; ++k) {
+                Block& victim = blocks[(self + k) % threads];
+                lock_guard<mutex> lock(victim.m);
+                size_t left = victim.end - victim.next;
+                if (left == 0) continue;
+                hi = victim.end;
+                lo = victim.end - (left + 1) / 2;
+                victim.end = lo;
+            }
+            if (lo == hi) return; // nothing left anywhere
+            lock_guard<mutex> lock(own.m);
+            own.next = lo;
+            own.end = hi;
+        }
+    };
+    vector<thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker, t);
+    worker(0);
+    for (auto& t : pool) t.join();
+}
+
+// ===== Output =====
+// Plans are formatted into one reusable string buffer and flushed to a sink in a single write,
+// instead of streaming every line to cout and keeping a second copy for the file.
+enum class SinkMode { NONE, CONSOLE, FILE, BOTH };
+
+struct OutputSink {
+    ostream* console = nullptr;
+    ostream* file = nullptr;
+};
+
+OutputSink makeSink(SinkMode mode, ostream* file) {
+    OutputSink sink;
+    if (mode == SinkMode::CONSOLE || mode == SinkMode::BOTH) sink.console = &cout;
+    if (mode == SinkMode::FILE || mode == SinkMode::BOTH) sink.file = file;
+    return sink;
+}
+
+bool parseSinkMode(const string& s, SinkMode& mode) {
+    if (s == "none") mode = SinkMode::NONE;
+    else if (s == "console") mode = SinkMode::CONSOLE;
+    else if (s == "file") mode = SinkMode::FILE;
+    else if (s == "both") mode = SinkMode::BOTH;
+    else return false;
     return true;
 }
 
-// Print decks with 1-3 slots per row (top/bottom 1 slot), showing ULD ID and type
-// Print decks with support for multi-slot ULDs
-void printDeckColumnsASCII(const string& deckName, const Deck& deck,
-    const vector<Slot>& slots, const vector<ULDDBEntry>& uldb,
-    vector<string>* outputLines = nullptr)
-{
-    auto writeLine = [&](const string& s) {
-        cout << s << "\n";
-        if (outputLines) outputLines->push_back(s);
-        };
+// Write the buffer to every stream of the sink and clear it for reuse
+void flushSink(const OutputSink& sink, string& buf) {
+    ScopedTimer timer(Phase::SAVE);
+    if (sink.console) sink.console->write(buf.data(), buf.size());
+    if (sink.file) sink.file->write(buf.data(), buf.size());
+    buf.clear();
+}
 
-    writeLine("\n=== " + deckName + " Deck Load Plan (slots=" + to_string(deck.slots) + ") ===");
-    if (deck.slots == 0) return;
+bool saveLoadPlanToFile(const string& filename, const string& text) {
+    ScopedTimer timer(Phase::SAVE);
+    ofstream out(filename, ios::binary);
+    if (!out.is_open()) return false;
+    out.write(text.data(), text.size());
+    return (bool)out;
+}
+
+// Append s left-aligned in a field of width w (like << left << setw(w))
+void appendPadded(string& out, const string& s, size_t w) {
+    out += s;
+    if (s.size() < w) out.append(w - s.size(), ' ');
+}
+
+// Default ostream formatting of a double (%g, 6 significant digits)
+string formatNumber(double v) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%g", v);
+    return buf;
+}
+
+string formatFixed2(double v) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.2f", v);
+    return buf;
+}
+
+// Deck plans print boxes of DECK_BOX_WIDTH characters: '|' and a 10-character cell
+const int DECK_BOX_WIDTH = 11;
 
-    int boxWidth = 11;
+void appendCell(string& out, const string& text) {
+    out += '|';
+    out += text;
+    out.append(DECK_BOX_WIDTH - 1 - text.size(), ' ');
+}
 
-    // rows: center 3, edges 1
-    vector<vector<const Slot*>> rows;
-    if (!slots.empty()) rows.push_back({ &slots[0] });
+// Rows of the deck plan: the first and last slot alone, 3 slots per row between. The lines that
+// don't depend on the load are built here once per template; rendering copies them and writes the
+// occupied cells in place.
+void buildRenderRows(DeckLayout& layout) {
+    layout.renderRows.clear();
+    layout.renderBytes = 0;
+    auto addRow = [&](int first, int count) {
+        DeckRenderRow row;
+        row.first = first;
+        row.count = count;
+        for (int s = first; s < first + count; ++s) {
+            appendCell(row.emptyContent, layout.slotType[s] == SlotType::NOSE ? "  N  " :
+                layout.slotType[s] == SlotType::TAIL ? "  T  " : "");
+            appendCell(row.numbers, "#" + to_string(s + 1));
+            appendCell(row.blank, "");
+            row.border += '+';
+            row.border.append(DECK_BOX_WIDTH - 2, '-');
+        }
+        row.emptyContent += "|\n";
+        row.numbers += "|\n";
+        row.blank += "|\n";
+        row.border += "+\n";
+        size_t topBorder = count * (DECK_BOX_WIDTH * count - 1) + 2; // widest: every box spans the row
+        layout.renderBytes += topBorder + row.emptyContent.size() + row.numbers.size() + row.blank.size() + row.border.size();
+        layout.renderRows.push_back(std::move(row));
+    };
+    int n = layout.count;
+    if (n > 0) addRow(0, 1);
     int idx = 1;
-    while (idx < (int)slots.size() - 1) {
-        int remaining = (int)slots.size() - 1 - idx;
-        int rowSize = min(3, remaining);
-        vector<const Slot*> row;
-        for (int i = 0; i < rowSize; ++i) row.push_back(&slots[idx + i]);
-        rows.push_back(row);
+    while (idx < n - 1) {
+        int rowSize = min(3, n - 1 - idx);
+        addRow(idx, rowSize);
         idx += rowSize;
     }
-    if (idx < (int)slots.size()) rows.push_back({ &slots.back() });
+    if (idx < n) addRow(n - 1, 1);
+    layout.renderBytes += 64; // title line
+}
 
-    for (auto& row : rows) {
-        // Top border
-        string line;
-        for (auto* s : row) {
-            line += "+";
-            if (s->occupied && !s->occupantId.empty()) {
-                int width = 1;
-                for (size_t k = 1; k < row.size(); ++k) {
-                    if (row[k - 1]->occupantId == row[k]->occupantId) width++;
-                }
-                line += string(boxWidth * width - 2, '-');
-            }
-            else {
-                line += string(boxWidth - 2, '-');
-            }
-        }
-        line += "+";
-        writeLine(line);
+// Print decks with 1-3 slots per row (top/bottom 1 slot), showing ULD ID and type
+// Print decks with support for multi-slot ULDs
+void printDeckColumnsASCII(const string& deckName, const Deck& deck,
+    const DeckSlots& slots, const std::pmr::vector<ULD>& ulds, const ULDDB& uldb, string& out)
+{
+    ScopedTimer timer(Phase::RENDER);
+    const DeckLayout& layout = *slots.layout;
+    out.reserve(out.size() + layout.renderBytes + deckName.size());
+    char num[16];
+    out += "\n=== ";
+    out += deckName;
+    out += " Deck Load Plan (slots=";
+    out.append(num, snprintf(num, sizeof(num), "%d", deck.slots));
+    out += ") ===\n";
+    if (deck.slots == 0) return;
 
-        // Content lines (id/type)
-        line.clear();
-        for (auto* s : row) {
-            if (s->occupied) {
-                const ULDDBEntry* info = nullptr;
-                for (auto& u : uldb) {
-                    if (s->occupantId.rfind(u.prefix, 0) == 0) { info = &u; break; }
-                }
-                string typeStr = info ? "[" + info->uldType + "]" : "";
-                string fullText = s->occupantId + typeStr;
-                if ((int)fullText.size() > boxWidth - 2)
-                    fullText = fullText.substr(0, boxWidth - 2);
-                line += "|" + fullText + string(boxWidth - 1 - fullText.size(), ' ');
-            }
-            else {
-                string idLine = (s->slotType == SlotType::NOSE ? "  N  " :
-                    s->slotType == SlotType::TAIL ? "  T  " : "");
-                line += "|" + idLine + string(boxWidth - 1 - idLine.size(), ' ');
-            }
+    const int32_t* occ = slots.occupant.data();
+    const size_t textWidth = DECK_BOX_WIDTH - 2; // longest ID text in a cell
+    for (const DeckRenderRow& row : layout.renderRows) {
+        // Top border; an occupied box is widened by one box for every pair of equal neighbours in the row
+        int span = 1;
+        for (int k = 1; k < row.count; ++k) span += occ[row.first + k - 1] == occ[row.first + k];
+        for (int s = row.first; s < row.first + row.count; ++s) {
+            out += '+';
+            out.append(occ[s] >= 0 ? DECK_BOX_WIDTH * span - 2 : DECK_BOX_WIDTH - 2, '-');
         }
-        line += "|";
-        writeLine(line);
+        out += "+\n";
 
-        // Slot numbers
-        line.clear();
-        for (auto* s : row) {
-            string n = "#" + to_string(s->index + 1);
-            line += "|" + n + string(boxWidth - 1 - n.size(), ' ');
+        // ID line: the empty row with each occupied cell overwritten by "ID[type]", cut to the cell
+        size_t at = out.size();
+        out += row.emptyContent;
+        int32_t last = -1;
+        const ULDDBEntry* info = nullptr;
+        for (int k = 0; k < row.count; ++k) {
+            int32_t h = occ[row.first + k];
+            if (h < 0) continue;
+            if (h != last) { info = findULDEntry(uldb, ulds[h].id); last = h; } // a ULD's slots are adjacent
+            char* cell = &out[at + 1 + k * DECK_BOX_WIDTH];
+            memset(cell, ' ', DECK_BOX_WIDTH - 1);
+            size_t len = 0;
+            auto put = [&](const char* p, size_t n) {
+                n = min(n, textWidth - len);
+                memcpy(cell + len, p, n);
+                len += n;
+            };
+            put(ulds[h].id.data(), ulds[h].id.size());
+            if (info) { put("[", 1); put(info->uldType.data(), info->uldType.size()); put("]", 1); }
         }
-        line += "|";
-        writeLine(line);
 
-        // Weights
-        line.clear();
-        for (auto* s : row) {
-            string w = s->occupied ? to_string((int)s->occupantWeight) : "";
-            line += "|" + w + string(boxWidth - 1 - w.size(), ' ');
+        out += row.numbers;
+
+        // Weight line
+        at = out.size();
+        out += row.blank;
+        for (int k = 0; k < row.count; ++k) {
+            int s = row.first + k;
+            if (occ[s] < 0) continue;
+            int len = snprintf(num, sizeof(num), "%d", (int)slots.occupantWeight[s]);
+            memcpy(&out[at + 1 + k * DECK_BOX_WIDTH], num, min((size_t)len, (size_t)DECK_BOX_WIDTH - 1));
         }
-        line += "|";
-        writeLine(line);
 
-        // Bottom border
-        line.clear();
-        for (auto* s : row) line += "+" + string(boxWidth - 2, '-');
-        line += "+";
-        writeLine(line);
+        out += row.border;
     }
 }
 
 // --- Assign nose/tail slots automatically ---
-void assignSpecialSlots(Aircraft& ac) {
+void makeDeckLayout(DeckLayout& layout, DeckId id, const Deck& deck, int noseSlots, int tailSlots) {
+    layout.deck = id;
+    layout.count = deck.slots;
+    layout.arm.assign(deck.slotArms.begin(), deck.slotArms.begin() + deck.slots);
+    layout.slotType.assign(deck.slots, SlotType::NORMAL);
+    for (int i = 0; i < deck.slots; ++i) {
+        if (i < noseSlots) layout.slotType[i] = SlotType::NOSE;
+        else if (i >= deck.slots - tailSlots) layout.slotType[i] = SlotType::TAIL;
+    }
+}
+
+void assignSpecialSlots(const Aircraft& ac, DeckLayout& mainLayout, DeckLayout& lowerLayout) {
     int entryMainNoseSlots = 0;
     int entryMainTailSlots = 0;
     int entryLowerNoseSlots = 0;
@@ -301,183 +1008,3027 @@ void assignSpecialSlots(Aircraft& ac) {
         entryLowerTailSlots = 1;
     }
 
-    // Create slot vectors
-    vector<Slot> mainSlots(ac.mainDeck.slots);
-    vector<Slot> lowerSlots(ac.lowerDeck.slots);
+    makeDeckLayout(mainLayout, DeckId::MAIN, ac.mainDeck, entryMainNoseSlots, entryMainTailSlots);
+    makeDeckLayout(lowerLayout, DeckId::LOWER, ac.lowerDeck, entryLowerNoseSlots, entryLowerTailSlots);
+}
 
-    // main deck
-    for (int i = 0; i < ac.mainDeck.slots; ++i) {
-        mainSlots[i].deckName = "main";
-        mainSlots[i].index = i;
-        mainSlots[i].arm = ac.mainDeck.slotArms[i];
-        if (i < entryMainNoseSlots) mainSlots[i].slotType = SlotType::NOSE;
-        else if (i >= ac.mainDeck.slots - entryMainTailSlots) mainSlots[i].slotType = SlotType::TAIL;
-    }
+// Fill in default arms for decks whose DB entry has no (or mismatched) slotArms
+void applyDefaultArms(Aircraft& ac) {
+    if ((int)ac.mainDeck.slotArms.size() != ac.mainDeck.slots) ac.mainDeck.slotArms = generateDefaultArms(ac.mainDeck.slots, 18.0, 36.0);
+    if ((int)ac.lowerDeck.slotArms.size() != ac.lowerDeck.slots) ac.lowerDeck.slotArms = generateDefaultArms(ac.lowerDeck.slots, 12.0, 28.0);
+}
 
-    // lower deck
-    for (int i = 0; i < ac.lowerDeck.slots; ++i) {
-        lowerSlots[i].deckName = "lower";
-        lowerSlots[i].index = i;
-        lowerSlots[i].arm = ac.lowerDeck.slotArms[i];
-        if (i < entryLowerNoseSlots) lowerSlots[i].slotType = SlotType::NOSE;
-        else if (i >= ac.lowerDeck.slots - entryLowerTailSlots) lowerSlots[i].slotType = SlotType::TAIL;
-    }
+// ===== Slot occupancy bitmaps =====
+// One bit per slot, 64 slots per word. Finding a run of free slots is a few shifts and ANDs
+// per word instead of collecting and sorting candidate slot lists for every ULD. Which runs the
+// deck geometry allows at all is precomputed in the layout; only `occupied` changes per flight.
+struct DeckBitmap {
+    explicit DeckBitmap(std::pmr::memory_resource* mr = std::pmr::get_default_resource()) : occupied(mr) {}
+    const DeckLayout* layout = nullptr;
+    std::pmr::vector<uint64_t> occupied; // bit set = slot taken
+};
+
+inline int lowestSetBit(uint64_t x) {
+#ifdef _MSC_VER
+    unsigned long i; _BitScanForward64(&i, x); return (int)i;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
 
-    // Return by reference (or use globally in main)
-    ac.mainDeck.slotArms = ac.mainDeck.slotArms;
-    ac.lowerDeck.slotArms = ac.lowerDeck.slotArms;
+// Fill in the slot masks and per-width run tables of a layout whose slot types are set
+void buildRunTables(DeckLayout& layout) {
+    size_t words = (layout.count + 63) / 64;
+    layout.valid.assign(words, 0);
+    layout.special.assign(words, 0);
+    for (int i = 0; i < layout.count; ++i) {
+        uint64_t bit = uint64_t(1) << (i % 64);
+        layout.valid[i / 64] |= bit;
+        if (layout.slotType[i] != SlotType::NORMAL) layout.special[i / 64] |= bit;
+    }
+    for (int allow = 0; allow < 2; ++allow) {
+        auto& byWidth = layout.runStarts[allow];
+        auto& lists = layout.feasibleStarts[allow];
+        byWidth.assign(layout.count + 1, vector<uint64_t>(words, 0));
+        lists.assign(layout.count + 1, vector<int>());
+        for (int w = 1; w <= layout.count; ++w) {
+            for (int s = 0; s + w <= layout.count; ++s) {
+                bool ok = true;
+                for (int i = s; i < s + w && ok; ++i) ok = allow || layout.slotType[i] == SlotType::NORMAL;
+                if (!ok) continue;
+                byWidth[w][s / 64] |= uint64_t(1) << (s % 64);
+                lists[w].push_back(s);
+            }
+        }
+    }
+    layout.runArm.assign(layout.count + 1, vector<double>());
+    for (int w = 1; w <= layout.count; ++w) {
+        for (int s = 0; s + w <= layout.count; ++s) {
+            double arm = 0.0;
+            for (int i = s; i < s + w; ++i) arm += layout.arm[i];
+            layout.runArm[w].push_back(arm / w);
+        }
+    }
 }
 
+// Start indices the deck geometry allows for a ULD of this width, whatever is already loaded
+const vector<int>& feasibleStarts(const DeckLayout& layout, int width, bool allowSpecialSlots) {
+    static const vector<int> none;
+    if (width < 1 || width > layout.count) return none;
+    return layout.feasibleStarts[allowSpecialSlots][width];
+}
 
-int main() {
-    ios::sync_with_stdio(false); cin.tie(nullptr);
-    auto ulddb = loadULDDB("uld_db.json");
-    Slot* bestSlot = nullptr;
-    cout << "=== Manual ULD Load Planner ===\n";
+// 64 occupancy bits starting at slot wi*64 + k (0 past the end of the deck)
+inline uint64_t occupiedFrom(const DeckBitmap& bm, size_t wi, int k) {
+    size_t q = wi + k / 64;
+    int r = k % 64;
+    uint64_t bits = q < bm.occupied.size() ? bm.occupied[q] >> r : 0;
+    if (r && q + 1 < bm.occupied.size()) bits |= bm.occupied[q + 1] << (64 - r);
+    return bits;
+}
 
-    auto db = loadAircraftDB("aircraft_db.json");
-    if (!db.empty()) { cout << "Aircraft in DB:\n"; for (auto& kv : db) cout << " - " << kv.first << "\n"; }
+// Are slots start .. start+width-1 all empty? (bounds and nose/tail rules not checked)
+inline bool runFree(const DeckBitmap& bm, int start, int width) {
+    for (int i = start; i < start + width;) {
+        int bit = i % 64;
+        int n = min(width - (i - start), 64 - bit);
+        uint64_t mask = (n == 64 ? ~uint64_t(0) : ((uint64_t(1) << n) - 1)) << bit;
+        if (bm.occupied[i / 64] & mask) return false;
+        i += n;
+    }
+    return true;
+}
 
-    cout << "Enter aircraft model: ";
-    string model; getline(cin, model);
-    Aircraft ac;
-    if (!model.empty() && db.count(model)) {
-        ac = db[model];
-        cout << "Using DB entry for " << model << "\n";
+// First slot index starting `width` consecutive available slots, or -1 (untimed, see findFreeRun)
+int firstFreeRun(const DeckBitmap& bm, int width, bool allowSpecialSlots) {
+    const DeckLayout& layout = *bm.layout;
+    if (width < 1 || width > layout.count) return -1;
+    const vector<uint64_t>& starts = layout.runStarts[allowSpecialSlots][width];
+    for (size_t wi = 0; wi < starts.size(); ++wi) {
+        // bit i of runs survives only if the geometry allows the run and slots i .. i+width-1 are free
+        uint64_t runs = starts[wi];
+        for (int k = 0; k < width && runs; ++k) runs &= ~occupiedFrom(bm, wi, k);
+        if (runs) return int(wi * 64) + lowestSetBit(runs);
     }
-    else {
-        cout << "Custom aircraft\n";
-        cout << "Main deck slots: "; cin >> ac.mainDeck.slots;
-        cout << "Lower deck slots: "; cin >> ac.lowerDeck.slots; cin.ignore();
-        ac.model = model.empty() ? "CUSTOM" : model;
+    return -1;
+}
+
+int findFreeRun(const DeckBitmap& bm, int width, bool allowSpecialSlots) {
+    ScopedTimer timer(Phase::RUN_SEARCH);
+    return firstFreeRun(bm, width, allowSpecialSlots);
+}
+
+void markOccupied(DeckBitmap& bm, int start, int width) {
+    for (int i = start; i < start + width;) {
+        int bit = i % 64;
+        int n = min(width - (i - start), 64 - bit);
+        uint64_t mask = (n == 64 ? ~uint64_t(0) : ((uint64_t(1) << n) - 1)) << bit;
+        bm.occupied[i / 64] |= mask;
+        i += n;
     }
+}
 
-    if ((int)ac.mainDeck.slotArms.size() != ac.mainDeck.slots) ac.mainDeck.slotArms = generateDefaultArms(ac.mainDeck.slots, 18.0, 36.0);
-    if ((int)ac.lowerDeck.slotArms.size() != ac.lowerDeck.slots) ac.lowerDeck.slotArms = generateDefaultArms(ac.lowerDeck.slots, 12.0, 28.0);
+void clearOccupied(DeckBitmap& bm, int start, int width) {
+    for (int i = start; i < start + width;) {
+        int bit = i % 64;
+        int n = min(width - (i - start), 64 - bit);
+        uint64_t mask = (n == 64 ? ~uint64_t(0) : ((uint64_t(1) << n) - 1)) << bit;
+        bm.occupied[i / 64] &= ~mask;
+        i += n;
+    }
+}
 
-    // create slot vectors
-    vector<Slot> mainSlots(ac.mainDeck.slots), lowerSlots(ac.lowerDeck.slots);
+// Can a ULD occupy exactly slots start .. start+width-1?
+bool runAvailable(const DeckBitmap& bm, int start, int width, bool allowSpecialSlots) {
+    const DeckLayout& layout = *bm.layout;
+    if (start < 0 || width < 1 || start + width > layout.count) return false;
+    if (!(layout.runStarts[allowSpecialSlots][width][start / 64] >> (start % 64) & 1)) return false;
+    return runFree(bm, start, width);
+}
 
-    // main deck
-    // Collect all free slots into one vector
-    vector<Slot*> freeSlots;
-    for (auto& s : mainSlots) freeSlots.push_back(&s);
-    for (auto& s : lowerSlots) freeSlots.push_back(&s);
+// ===== Scoring kernel =====
+// Evaluates many candidate plans at once, one plan per SIMD lane. Each candidate is a parent's
+// totals plus one ULD of the step's weight placed at a run arm; the kernel forms the new weight and
+// moment (weight * arm), checks the weight against the MTW and scores |CG - target| (0 for an empty
+// plan). AVX2 (4 lanes) or NEON (2 lanes) is used when the compiler targets it (e.g. -mavx2 or
+// -march=native), with a scalar loop for the tail and for other targets. Every path does the same
+// IEEE operations, so the totals, the scores and the plans ranked by them are identical whichever
+// one is compiled in. That needs contraction off here: with FMA available the compiler may fuse
+// the tail's weight * arm + moment (GCC does by default) while the lanes round the product first.
+struct CandidateScores {
+    explicit CandidateScores(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : weight(mr), moment(mr), deviation(mr), fits(mr) {}
+    // one entry per candidate plan, updated in place
+    std::pmr::vector<double> weight, moment; // in: parent totals, out: totals with the ULD placed
+    std::pmr::vector<double> deviation;      // in: run arm of the placement, out: |CG - target|
+    std::pmr::vector<uint8_t> fits;          // out: weight within the MTW
+};
 
-    // assign greedily (safe version with multi-slot placement)
-    vector<ULD> ulds;
-    int nULDs = promptInt("Number of ULDs: ");
-    for (int i = 0; i < nULDs; ++i) {
-        ULD u;
-        while (true) {
-            cout << "ULD #" << (i + 1) << " ID: ";
-            getline(cin, u.id);
-            if (!u.id.empty()) break;
-        }
-        u.weight = promptDouble("ULD " + u.id + " weight (kg): ");
-        cout << "ULD type (MAIN / LOWER / ANY): ";
-        string t; getline(cin, t);
-        // Normalize input to uppercase
-        std::transform(t.begin(), t.end(), t.begin(), ::toupper);
-        if (t == "MAIN") u.type = ULD::Type::MAIN;
-        else if (t == "LOWER") u.type = ULD::Type::LOWER;
-        else u.type = ULD::Type::ANY;
-        cout << "Allow nose/tail? (y/n): "; getline(cin, t);
-        // Accept "y", "Y", "yes", "YES" (case-insensitive)
-        std::transform(t.begin(), t.end(), t.begin(), ::tolower);
-        u.allowSpecialSlots = (t == "y" || t == "yes");
-        ulds.push_back(u);
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER) && !defined(__clang__)
+#pragma fp_contract(off)
+#endif
+void scoreCandidates(CandidateScores& c, double uldWeight, double targetCG, double mtw) {
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#endif
+    size_t n = c.weight.size();
+    c.fits.resize(n);
+    double* w = c.weight.data();
+    double* m = c.moment.data();
+    double* dev = c.deviation.data();
+    uint8_t* fits = c.fits.data();
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256d add = _mm256_set1_pd(uldWeight), target = _mm256_set1_pd(targetCG), limit = _mm256_set1_pd(mtw);
+    const __m256d zero = _mm256_setzero_pd(), signBit = _mm256_set1_pd(-0.0);
+    for (; i + 4 <= n; i += 4) {
+        __m256d wv = _mm256_add_pd(_mm256_loadu_pd(w + i), add);
+        __m256d mv = _mm256_add_pd(_mm256_loadu_pd(m + i), _mm256_mul_pd(add, _mm256_loadu_pd(dev + i)));
+        __m256d d = _mm256_andnot_pd(signBit, _mm256_sub_pd(_mm256_div_pd(mv, wv), target));
+        _mm256_storeu_pd(w + i, wv);
+        _mm256_storeu_pd(m + i, mv);
+        _mm256_storeu_pd(dev + i, _mm256_and_pd(d, _mm256_cmp_pd(wv, zero, _CMP_GT_OQ)));
+        // 0/1 per lane, narrowed to four bytes
+        __m256i within = _mm256_srli_epi64(_mm256_castpd_si256(_mm256_cmp_pd(wv, limit, _CMP_LE_OQ)), 63);
+        __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(within), _mm256_extracti128_si256(within, 1));
+        packed = _mm_packus_epi16(packed, packed);
+        int32_t four = _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+        memcpy(fits + i, &four, 4);
     }
-
-    // Add a check for empty DBs after loading:
-    if (ulddb.empty()) {
-        cout << RED << "Warning: ULD database is empty or missing. Multi-slot ULDs may not be recognized." << RESET << "\n";
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    const float64x2_t add = vdupq_n_f64(uldWeight), target = vdupq_n_f64(targetCG);
+    const float64x2_t limit = vdupq_n_f64(mtw), zero = vdupq_n_f64(0.0);
+    for (; i + 2 <= n; i += 2) {
+        float64x2_t wv = vaddq_f64(vld1q_f64(w + i), add);
+        float64x2_t mv = vaddq_f64(vld1q_f64(m + i), vmulq_f64(add, vld1q_f64(dev + i)));
+        float64x2_t d = vabsq_f64(vsubq_f64(vdivq_f64(mv, wv), target));
+        uint64x2_t positive = vcgtq_f64(wv, zero), within = vcleq_f64(wv, limit);
+        vst1q_f64(w + i, wv);
+        vst1q_f64(m + i, mv);
+        vst1q_f64(dev + i, vreinterpretq_f64_u64(vandq_u64(vreinterpretq_u64_f64(d), positive)));
+        fits[i] = (uint8_t)(vgetq_lane_u64(within, 0) & 1);
+        fits[i + 1] = (uint8_t)(vgetq_lane_u64(within, 1) & 1);
     }
-    if (db.empty()) {
-        cout << RED << "Warning: Aircraft database is empty or missing. Only custom aircraft can be entered." << RESET << "\n";
+#endif
+    for (; i < n; ++i) {
+        w[i] += uldWeight;
+        m[i] += uldWeight * dev[i];
+        dev[i] = w[i] > 0 ? fabs(m[i] / w[i] - targetCG) : 0.0;
+        fits[i] = w[i] <= mtw;
     }
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC pop_options
+#endif
 
-    double avgArm = 0.0;
-    for (auto* s : freeSlots) avgArm += s->arm;
-    if (!freeSlots.empty()) avgArm /= freeSlots.size();
-
-    double currentWeight = 0.0, currentMoment = 0.0;
-    vector<pair<string, string>> report;
+// ===== Per-flight arena =====
+// Bump allocator for one flight's planning state. Deallocation is a no-op and reset() drops
+// everything at once between flights. A flight that outgrows the block takes the excess from the
+// heap, and the next reset() grows the block to cover it, so once warmed up (a flight or two per
+// aircraft size) planning does no heap allocation at all.
+class PlanArena : public std::pmr::memory_resource {
+public:
+    explicit PlanArena(size_t initialBytes = 64 * 1024) : block(initialBytes) {}
+    PlanArena(const PlanArena&) = delete;
+    PlanArena& operator=(const PlanArena&) = delete;
+    ~PlanArena() override { freeOverflow(); }
 
-    for (auto& u : ulds) {
-        int uWidth = getULDWidth(ulddb, u.id);
-        if (uWidth <= 0) uWidth = 1; ;
+    // Everything allocated from the arena must be destroyed before this
+    void reset() {
+        size_t needed = used + overflowBytes;
+        freeOverflow();
+        if (needed > block.size()) block.assign(needed + needed / 2, 0);
+        used = 0;
+    }
+    size_t capacity() const { return block.size(); }
+    size_t peakBytes() const { return peak; } // most ever in use at once, over the arena's life
 
-        // filter slots by deck type
-        vector<Slot*> candidates;
-        for (auto* s : freeSlots) {
-            if ((u.type == ULD::Type::MAIN && s->deckName != "main") ||
-                (u.type == ULD::Type::LOWER && s->deckName != "lower"))
-                continue;
-            if (!u.allowSpecialSlots && (s->slotType == SlotType::NOSE || s->slotType == SlotType::TAIL))
-                continue;
-            candidates.push_back(s);
+private:
+    void* do_allocate(size_t bytes, size_t align) override {
+        uintptr_t base = (uintptr_t)block.data();
+        size_t start = (size_t)(((base + used + align - 1) & ~(uintptr_t)(align - 1)) - base);
+        if (start + bytes <= block.size()) {
+            used = start + bytes;
+            peak = max(peak, used + overflowBytes);
+            return block.data() + start;
         }
+        void* p = ::operator new(bytes, std::align_val_t(align));
+        overflow.push_back({ p, align });
+        overflowBytes += bytes + align;
+        peak = max(peak, used + overflowBytes);
+        return p;
+    }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
 
-        std::sort(candidates.begin(), candidates.end(),
-            [](Slot* a, Slot* b) { return a->index < b->index; });
+    void freeOverflow() {
+        for (auto& o : overflow) ::operator delete(o.first, std::align_val_t(o.second));
+        overflow.clear();
+        overflowBytes = 0;
+    }
 
-        bool placed = false;
-        for (size_t i = 0; i + uWidth <= candidates.size(); ++i) {
-            bool consecutive = true;
-            for (int w = 1; w < uWidth; ++w) {
-                if (candidates[i + w]->index != candidates[i + w - 1]->index + 1) {
-                    consecutive = false; break;
+    vector<unsigned char> block;
+    size_t used = 0;
+    vector<pair<void*, size_t>> overflow; // blocks that didn't fit, with their alignment
+    size_t overflowBytes = 0;
+    size_t peak = 0;
+};
+
+// The plan's own storage, plus two scratch arenas the optimizer alternates between
+struct FlightArena {
+    PlanArena plan;
+    PlanArena scratch[2];
+};
+
+// Call between flights, once the previous flight's plan is gone
+void resetFlightArena(FlightArena& arena) {
+    arena.plan.reset();
+    arena.scratch[0].reset();
+    arena.scratch[1].reset();
+}
+
+// ===== Planning =====
+struct Placement {
+    int start = -1; // first slot index, -1 = unassigned
+    int width = 0;  // slots the ULD covers, kept while unassigned so it can be placed later
+    bool onMain = false;
+};
+
+struct MassTotals {
+    double weight = 0.0;
+    double moment = 0.0;
+};
+
+struct LoadPlan;
+struct FixedGeometry; // compile-time deck geometry, see "Fixed deck geometries"
+
+// Everything about an aircraft model that doesn't change between flights: the aircraft with its
+// default arms filled in, the deck layouts and their run tables. Built once per model and shared.
+struct AircraftTemplate {
+    Aircraft ac;
+    DeckLayout mainLayout;
+    DeckLayout lowerLayout;
+    const FixedGeometry* fixed = nullptr; // compiled geometry matching both layouts, if any
+};
+
+// Per-flight storage comes from the memory resource the plan was made with (see FlightArena)
+struct LoadPlan {
+    explicit LoadPlan(std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+        : mainSlots(mr), lowerSlots(mr), mainBits(mr), lowerBits(mr), uldTable(mr), report(mr), placements(mr) {}
+    shared_ptr<const AircraftTemplate> tmpl;
+    DeckSlots mainSlots;
+    DeckSlots lowerSlots;
+    DeckBitmap mainBits;
+    DeckBitmap lowerBits;
+    ULDTable uldTable;                    // the planned ULDs; handles index this and placements
+    std::pmr::vector<int32_t> report;     // ULD handles in report order
+    std::pmr::vector<Placement> placements; // per handle
+    double totalWeight = 0.0;
+    double totalMoment = 0.0;
+    MassTotals deckTotals[2];    // per DeckId
+    MassTotals zoneTotals[2][3]; // per DeckId and SlotType (nose / body / tail zones)
+};
+
+ULD::Type parseULDType(string t) {
+    // Normalize input to uppercase
+    std::transform(t.begin(), t.end(), t.begin(), ::toupper);
+    if (t == "MAIN") return ULD::Type::MAIN;
+    if (t == "LOWER") return ULD::Type::LOWER;
+    return ULD::Type::ANY;
+}
+
+bool parseYesNo(string t) {
+    // Accept "y", "Y", "yes", "YES" (case-insensitive)
+    std::transform(t.begin(), t.end(), t.begin(), ::tolower);
+    return t == "y" || t == "yes" || t == "true" || t == "1";
+}
+
+enum class PlanEngine { GREEDY, OPTIMIZE, LOWER_DP };
+
+struct PlanOptions {
+    PlanEngine engine = PlanEngine::GREEDY;
+    double targetCG = NAN;  // arm to balance around; NAN = mean arm of all slots
+    int timeBudgetMs = 50;  // optimizer search budget per flight; 0 = unlimited
+    int beamWidth = 64;     // optimizer states kept per ULD
+};
+
+const FixedGeometry* findFixedGeometry(const AircraftTemplate& t);
+
+shared_ptr<const AircraftTemplate> makeAircraftTemplate(const Aircraft& aircraft) {
+    ScopedTimer timer(Phase::TEMPLATE_BUILD);
+    auto t = make_shared<AircraftTemplate>();
+    t->ac = aircraft;
+    applyDefaultArms(t->ac);
+    assignSpecialSlots(t->ac, t->mainLayout, t->lowerLayout);
+    buildRunTables(t->mainLayout);
+    buildRunTables(t->lowerLayout);
+    buildRenderRows(t->mainLayout);
+    buildRenderRows(t->lowerLayout);
+    t->fixed = findFixedGeometry(*t);
+    return t;
+}
+
+void initEmptyDeck(DeckSlots& slots, DeckBitmap& bm, const DeckLayout& layout) {
+    slots.layout = &layout;
+    slots.occupantWeight.assign(layout.count, 0.0);
+    slots.occupant.assign(layout.count, -1);
+    bm.layout = &layout;
+    bm.occupied.assign(layout.valid.size(), 0);
+}
+
+// Fresh, empty occupancy state for one flight; the geometry is shared with the template
+LoadPlan makeEmptyPlan(const shared_ptr<const AircraftTemplate>& tmpl,
+    std::pmr::memory_resource* mr = std::pmr::get_default_resource()) {
+    LoadPlan plan(mr);
+    plan.tmpl = tmpl;
+    initEmptyDeck(plan.mainSlots, plan.mainBits, tmpl->mainLayout);
+    initEmptyDeck(plan.lowerSlots, plan.lowerBits, tmpl->lowerLayout);
+    return plan;
+}
+
+// Templates per aircraft model, built on first use
+struct TemplateCache {
+    map<string, shared_ptr<const AircraftTemplate>> byModel;
+};
+
+shared_ptr<const AircraftTemplate> findTemplate(TemplateCache& cache, const map<string, Aircraft>& db, const string& model) {
+    auto it = cache.byModel.find(model);
+    if (it != cache.byModel.end()) return it->second;
+    auto ac = db.find(model);
+    if (ac == db.end()) return nullptr;
+    return cache.byModel.emplace(model, makeAircraftTemplate(ac->second)).first->second;
+}
+
+shared_ptr<const AircraftTemplate> findTemplate(TemplateCache& cache, AircraftDB& db, const string& model) {
+    auto it = cache.byModel.find(model);
+    if (it != cache.byModel.end()) return it->second;
+    const Aircraft* ac = findAircraft(db, model);
+    if (!ac) return nullptr;
+    return cache.byModel.emplace(model, makeAircraftTemplate(*ac)).first->second;
+}
+
+double meanSlotArm(const LoadPlan& plan) {
+    const DeckLayout& m = plan.tmpl->mainLayout;
+    const DeckLayout& l = plan.tmpl->lowerLayout;
+    double avgArm = 0.0;
+    for (double a : m.arm) avgArm += a;
+    for (double a : l.arm) avgArm += a;
+    if (m.count + l.count > 0) avgArm /= (m.count + l.count);
+    return avgArm;
+}
+
+// Arm of a ULD spread evenly over slots start .. start+width-1
+double runArm(const DeckSlots& deckSlots, int start, int width) {
+    return deckSlots.layout->runArm[width][start];
+}
+
+// Add (sign 1) or take away (sign -1) a ULD's share of each slot in the run from the deck and zone totals
+void accumulateRun(LoadPlan& plan, bool onMain, int start, int width, double weight, double sign) {
+    const DeckLayout& layout = *(onMain ? plan.mainSlots : plan.lowerSlots).layout;
+    MassTotals& deck = plan.deckTotals[(int)layout.deck];
+    double share = sign * weight / width;
+    for (int w = start; w < start + width; ++w) {
+        MassTotals& zone = plan.zoneTotals[(int)layout.deck][(int)layout.slotType[w]];
+        zone.weight += share;
+        zone.moment += share * layout.arm[w];
+        deck.weight += share;
+        deck.moment += share * layout.arm[w];
+    }
+}
+
+void placeULD(LoadPlan& plan, const ULD& u, int handle, bool onMain, int start, int width) {
+    DeckSlots& deckSlots = onMain ? plan.mainSlots : plan.lowerSlots;
+    markOccupied(onMain ? plan.mainBits : plan.lowerBits, start, width);
+
+    // place ULD
+    for (int w = 0; w < width; ++w) {
+        deckSlots.occupant[start + w] = handle;
+        deckSlots.occupantWeight[start + w] = u.weight / width;
+    }
+
+    plan.totalWeight += u.weight;
+    plan.totalMoment += u.weight * runArm(deckSlots, start, width);
+    accumulateRun(plan, onMain, start, width, u.weight, 1.0);
+}
+
+void unplaceULD(LoadPlan& plan, const ULD& u, bool onMain, int start, int width) {
+    DeckSlots& deckSlots = onMain ? plan.mainSlots : plan.lowerSlots;
+    clearOccupied(onMain ? plan.mainBits : plan.lowerBits, start, width);
+
+    for (int w = 0; w < width; ++w) {
+        deckSlots.occupant[start + w] = -1;
+        deckSlots.occupantWeight[start + w] = 0.0;
+    }
+
+    plan.totalWeight -= u.weight;
+    plan.totalMoment -= u.weight * runArm(deckSlots, start, width);
+    accumulateRun(plan, onMain, start, width, u.weight, -1.0);
+}
+
+// Metrics only: count why a ULD can't go on one deck of the plan as it stands
+void countRejection(const LoadPlan& plan, const ULD& u, bool onMain, int width) {
+    if ((onMain && u.type == ULD::Type::LOWER) || (!onMain && u.type == ULD::Type::MAIN)) countEvent(Counter::REJECT_DECK_MISMATCH);
+    else if (!u.allowSpecialSlots && firstFreeRun(onMain ? plan.mainBits : plan.lowerBits, width, true) >= 0) countEvent(Counter::REJECT_NOSE_TAIL);
+    else if (firstFreeRun(onMain ? plan.mainBits : plan.lowerBits, width, u.allowSpecialSlots) < 0) countEvent(Counter::REJECT_NO_RUN);
+}
+
+string slotLabel(bool onMain, int start) {
+    return string(deckName(onMain ? DeckId::MAIN : DeckId::LOWER)) + "[" + to_string(start + 1) + "]";
+}
+
+// The first-fit decision for one ULD, shared by the runtime and the compiled decks: the first free run
+// on its allowed decks, lowest slot number wins, main deck first on ties. findMain/findLower(width,
+// allowSpecialSlots) return a run start or -1. Nothing is placed; an unassigned ULD is counted here.
+template <typename FindMain, typename FindLower>
+Placement chooseFirstFit(const LoadPlan& plan, const ULD& u, int width, FindMain findMain, FindLower findLower) {
+    int mainStart = u.type != ULD::Type::LOWER ? findMain(width, u.allowSpecialSlots) : -1;
+    int lowerStart = u.type != ULD::Type::MAIN ? findLower(width, u.allowSpecialSlots) : -1;
+
+    bool useMain = mainStart >= 0 && (lowerStart < 0 || mainStart <= lowerStart);
+    int start = useMain ? mainStart : lowerStart;
+    if (start < 0) {
+        countEvent(Counter::UNASSIGNED);
+        if (g_metrics.enabled) { // only ULDs left unassigned, as the optimizer counts them
+            countRejection(plan, u, true, width);
+            countRejection(plan, u, false, width);
+        }
+        return { -1, width, false };
+    }
+    return { start, width, useMain };
+}
+
+// Put one ULD in the first free run on its allowed decks (see chooseFirstFit)
+Placement placeFirstFit(LoadPlan& plan, const ULD& u, int handle, int width) {
+    Placement pl = chooseFirstFit(plan, u, width,
+        [&](int w, bool special) { return findFreeRun(plan.mainBits, w, special); },
+        [&](int w, bool special) { return findFreeRun(plan.lowerBits, w, special); });
+    if (pl.start >= 0) placeULD(plan, u, handle, pl.onMain, pl.start, width);
+    return pl;
+}
+
+// Greedy first-fit placement of ulds (in order) onto the decks of an empty plan
+LoadPlan planGreedy(LoadPlan plan, const vector<ULD>& ulds, const ULDDB& ulddb) {
+    fillULDTable(plan.uldTable, ulds);
+    auto& report = plan.report;
+
+    for (int handle = 0; handle < (int)ulds.size(); ++handle) {
+        const ULD& u = ulds[handle];
+        countEvent(Counter::PLACEMENT_ATTEMPTS);
+        int uWidth = max(1, getULDWidth(ulddb, u.id));
+        plan.placements.push_back(placeFirstFit(plan, u, handle, uWidth));
+        report.push_back(handle);
+    }
+    return plan;
+}
+
+// ===== Fixed deck geometries =====
+// The fleet's common types also have their decks described at compile time. FixedDeck<Slots, Fore, Aft>
+// holds the slot mask, the nose/tail mask (first and last slot, as assignSpecialSlots lays them out),
+// the allowed run starts per width and the default arms (fore/aft in tenths) as constants; every deck
+// fits one 64-bit word. planGreedyFixed is the greedy engine instantiated for a main/lower pair: its
+// first-fit search is shift-ANDs on a local word against constant tables. A template uses it only if
+// both runtime layouts match the compiled ones (slot count and nose/tail slots exactly, arms within
+// ARM_TOLERANCE: the runtime arms come from DB values or generateDefaultArms, not this constexpr copy);
+// everything else, including custom aircraft entered at the prompt, keeps the runtime Deck/DeckLayout
+// path. Moments still use the runtime arms either way.
+template <int Slots, int ForeTenths, int AftTenths>
+struct FixedDeck {
+    static_assert(Slots >= 0 && Slots <= 64, "a fixed deck fits one bitmap word");
+    static constexpr uint64_t bits(int from, int n) {
+        return n <= 0 ? 0 : (n >= 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1) << from;
+    }
+    static constexpr uint64_t valid = bits(0, Slots);
+    static constexpr uint64_t special = Slots > 0 ? (uint64_t(1) | uint64_t(1) << (Slots - 1)) : 0;
+
+    // [allowSpecialSlots][width]: bit s set = a run of width slots may start at s
+    static constexpr array<array<uint64_t, Slots + 1>, 2> makeRunStarts() {
+        array<array<uint64_t, Slots + 1>, 2> t{};
+        for (int allow = 0; allow < 2; ++allow)
+            for (int w = 1; w <= Slots; ++w)
+                for (int s0 = 0; s0 + w <= Slots; ++s0)
+                    if (allow || !(special & bits(s0, w))) t[allow][w] |= uint64_t(1) << s0;
+        return t;
+    }
+    static constexpr array<array<uint64_t, Slots + 1>, 2> runStarts = makeRunStarts();
+
+    // same interpolation as generateDefaultArms
+    static constexpr array<double, Slots> makeArms() {
+        array<double, Slots> a{};
+        double fore = ForeTenths / 10.0, aft = AftTenths / 10.0;
+        for (int i = 0; i < Slots; ++i) {
+            if (Slots == 1) { a[i] = (fore + aft) / 2.0; break; }
+            double t = double(i) / double(Slots - 1);
+            a[i] = fore * (1 - t) + aft * t;
+        }
+        return a;
+    }
+    static constexpr array<double, Slots> arms = makeArms();
+    static constexpr double ARM_TOLERANCE = 1e-9;
+
+    static int firstFreeRun(uint64_t occupied, int width, bool allowSpecialSlots) {
+        if (width < 1 || width > Slots) return -1;
+        uint64_t runs = runStarts[allowSpecialSlots][width], free = ~occupied & valid;
+        for (int k = 0; k < width && runs; ++k) runs &= free >> k;
+        return runs ? lowestSetBit(runs) : -1;
+    }
+    static int findFreeRun(uint64_t occupied, int width, bool allowSpecialSlots) {
+        ScopedTimer timer(Phase::RUN_SEARCH);
+        return firstFreeRun(occupied, width, allowSpecialSlots);
+    }
+
+    static bool matches(const DeckLayout& layout) {
+        if (layout.count != Slots) return false;
+        for (int i = 0; i < Slots; ++i) {
+            if (fabs(layout.arm[i] - arms[i]) > ARM_TOLERANCE) return false;
+            if ((layout.slotType[i] != SlotType::NORMAL) != (special >> i & 1)) return false;
+        }
+        return true;
+    }
+};
+
+template <typename Main, typename Lower>
+LoadPlan planGreedyFixed(LoadPlan plan, const vector<ULD>& ulds, const ULDDB& ulddb) {
+    fillULDTable(plan.uldTable, ulds);
+    uint64_t mainOccupied = 0, lowerOccupied = 0;
+    for (int handle = 0; handle < (int)ulds.size(); ++handle) {
+        const ULD& u = ulds[handle];
+        countEvent(Counter::PLACEMENT_ATTEMPTS);
+        int uWidth = max(1, getULDWidth(ulddb, u.id));
+
+        Placement pl = chooseFirstFit(plan, u, uWidth,
+            [&](int w, bool special) { return Main::findFreeRun(mainOccupied, w, special); },
+            [&](int w, bool special) { return Lower::findFreeRun(lowerOccupied, w, special); });
+        if (pl.start >= 0) {
+            if (pl.onMain) mainOccupied |= Main::bits(pl.start, uWidth);
+            else lowerOccupied |= Lower::bits(pl.start, uWidth);
+            placeULD(plan, u, handle, pl.onMain, pl.start, uWidth);
+        }
+        plan.placements.push_back(pl);
+        plan.report.push_back(handle);
+    }
+    return plan;
+}
+
+struct FixedGeometry {
+    const char* models;
+    bool (*matches)(const AircraftTemplate& t);
+    LoadPlan (*planGreedy)(LoadPlan plan, const vector<ULD>& ulds, const ULDDB& ulddb);
+};
+
+// main deck arms 18.0-36.0, lower deck 12.0-28.0, as applyDefaultArms
+template <int MainSlots, int LowerSlots>
+constexpr FixedGeometry fixedGeometry(const char* models) {
+    using Main = FixedDeck<MainSlots, 180, 360>;
+    using Lower = FixedDeck<LowerSlots, 120, 280>;
+    return { models,
+        [](const AircraftTemplate& t) { return Main::matches(t.mainLayout) && Lower::matches(t.lowerLayout); },
+        planGreedyFixed<Main, Lower> };
+}
+
+const FixedGeometry FIXED_GEOMETRIES[] = {
+    fixedGeometry<22, 26>("A330-200"),
+    fixedGeometry<0, 22>("B767-200"),
+    fixedGeometry<0, 24>("B767-300"),
+    fixedGeometry<0, 28>("B767-400"),
+    fixedGeometry<27, 32>("B777-200"),
+    fixedGeometry<32, 44>("B777-300"),
+};
+
+// Matched on geometry, so another model with the same decks gets the compiled path too
+const FixedGeometry* findFixedGeometry(const AircraftTemplate& t) {
+    for (const FixedGeometry& g : FIXED_GEOMETRIES)
+        if (g.matches(t)) return &g;
+    return nullptr;
+}
+
+// Beam search over slot assignments, heaviest ULD first. Each state keeps its own occupancy
+// bitmaps; states are ranked by ULDs placed, then by distance of the CG from the target.
+// Each step lists every placement as a (parent, move) candidate, and scoreCandidates forms their
+// totals, MTW check and scores together. A parent with no placement within the MTW keeps the ULD
+// unassigned instead, with its own totals. Only the states that survive into the beam are copied out.
+// When the time budget runs out the beam narrows to 1, so a complete plan is always returned.
+// A budget of 0 means no time limit: the full beam runs for every ULD, so the plan depends only on the input.
+// With an arena, the beam lives in one scratch arena while its successors are built in the other;
+// the older one is reset before each step, so scratch memory stays at about two beams.
+LoadPlan planOptimized(LoadPlan plan, const vector<ULD>& ulds, const ULDDB& ulddb, const PlanOptions& opts,
+    FlightArena* arena = nullptr) {
+    using Clock = chrono::steady_clock;
+    auto deadline = Clock::now() + chrono::milliseconds(opts.timeBudgetMs);
+
+    fillULDTable(plan.uldTable, ulds);
+    double target = std::isnan(opts.targetCG) ? meanSlotArm(plan) : opts.targetCG;
+    double mtw = plan.tmpl->ac.mtw > 0 ? plan.tmpl->ac.mtw : INFINITY;
+
+    std::pmr::memory_resource* planMem = plan.report.get_allocator().resource();
+    std::pmr::memory_resource* scratch[2] = { std::pmr::get_default_resource(), std::pmr::get_default_resource() };
+    if (arena) { scratch[0] = &arena->scratch[0]; scratch[1] = &arena->scratch[1]; }
+
+    std::pmr::vector<int> widths(ulds.size(), planMem);
+    std::pmr::vector<size_t> order(ulds.size(), planMem);
+    for (size_t i = 0; i < ulds.size(); ++i) {
+        widths[i] = max(1, getULDWidth(ulddb, ulds[i].id));
+        order[i] = i;
+    }
+    // heaviest first, ties in manifest order (std::sort with an index tie-break instead of
+    // stable_sort, which would take a heap buffer)
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return ulds[a].weight != ulds[b].weight ? ulds[a].weight > ulds[b].weight : a < b;
+    });
+
+    struct BeamState {
+        explicit BeamState(std::pmr::memory_resource* mr) : mainBits(mr), lowerBits(mr), start(mr), onMain(mr) {}
+        DeckBitmap mainBits, lowerBits;
+        double weight = 0.0, moment = 0.0, deviation = 0.0;
+        int assigned = 0;
+        std::pmr::vector<int> start; // per ULD: slot index, -1 unassigned, -2 left out to stay within MTW
+        std::pmr::vector<char> onMain;
+    };
+    auto better = [&](const BeamState& a, const BeamState& b) {
+        if (a.assigned != b.assigned) return a.assigned > b.assigned;
+        return a.deviation < b.deviation;
+    };
+
+    // states[cur] is the beam, states[cur ^ 1] receives its successors; each sits in its own arena
+    std::pmr::vector<BeamState> states[2] = { std::pmr::vector<BeamState>(scratch[0]), std::pmr::vector<BeamState>(scratch[1]) };
+    int cur = 0;
+    BeamState& root = states[cur].emplace_back(scratch[cur]);
+    root.mainBits = plan.mainBits;
+    root.lowerBits = plan.lowerBits;
+    root.start.assign(ulds.size(), -1);
+    root.onMain.assign(ulds.size(), 0);
+
+    // successors of the current beam: parent state and move (start < 0: ULD left unassigned),
+    // with totals and scores in lanes; firstMove[p] is where parent p's placements begin and rank
+    // holds the candidates that are kept
+    struct Move { int32_t parent; int32_t start; bool onMain; };
+    std::pmr::vector<Move> moves(planMem);
+    std::pmr::vector<int32_t> assigned(planMem), rank(planMem), firstMove(planMem);
+    CandidateScores cand(planMem);
+
+    for (size_t ui : order) {
+        const ULD& u = ulds[ui];
+        int width = widths[ui];
+        size_t beamWidth = opts.timeBudgetMs <= 0 || Clock::now() < deadline ? (size_t)max(1, opts.beamWidth) : 1;
+
+        const std::pmr::vector<BeamState>& beam = states[cur];
+        moves.clear(); cand.deviation.clear(); firstMove.clear();
+        ScopedTimer filterTimer(Phase::CANDIDATE_FILTER);
+        for (int32_t p = 0; p < (int32_t)beam.size(); ++p) {
+            const BeamState& st = beam[p];
+            firstMove.push_back((int32_t)moves.size());
+            for (int deck = 0; deck < 2; ++deck) {
+                bool onMain = deck == 0;
+                if ((onMain && u.type == ULD::Type::LOWER) || (!onMain && u.type == ULD::Type::MAIN)) continue;
+                const DeckBitmap& bm = onMain ? st.mainBits : st.lowerBits;
+                const DeckSlots& deckSlots = onMain ? plan.mainSlots : plan.lowerSlots;
+
+                // every free run, not just the first one
+                for (int s0 : feasibleStarts(*deckSlots.layout, width, u.allowSpecialSlots)) {
+                    if (!runFree(bm, s0, width)) continue;
+                    moves.push_back({ p, s0, onMain });
+                    cand.deviation.push_back(runArm(deckSlots, s0, width));
+                }
+            }
+        }
+        firstMove.push_back((int32_t)moves.size());
+        filterTimer.stop();
+
+        // each parent's totals into the lanes of its placements, with room for a fallback per parent
+        size_t placements = moves.size(), most = placements + beam.size();
+        moves.reserve(most); cand.deviation.reserve(most);
+        cand.weight.reserve(most); cand.moment.reserve(most); assigned.reserve(most);
+        cand.weight.resize(placements); cand.moment.resize(placements); assigned.resize(placements);
+        for (int32_t p = 0; p < (int32_t)beam.size(); ++p) {
+            const BeamState& st = beam[p];
+            std::fill(cand.weight.begin() + firstMove[p], cand.weight.begin() + firstMove[p + 1], st.weight);
+            std::fill(cand.moment.begin() + firstMove[p], cand.moment.begin() + firstMove[p + 1], st.moment);
+            std::fill(assigned.begin() + firstMove[p], assigned.begin() + firstMove[p + 1], st.assigned + 1);
+        }
+        scoreCandidates(cand, u.weight, target, mtw);
+
+        // keep the placements within the MTW (a parent's placements all weigh the same, so they
+        // fit or not together); a parent left with none keeps the ULD unassigned, marked as an MTW
+        // rejection if it had placements
+        rank.clear();
+        for (int32_t p = 0; p < (int32_t)beam.size(); ++p) {
+            int32_t begin = firstMove[p], end = firstMove[p + 1];
+            if (begin < end && cand.fits[begin]) {
+                for (int32_t i = begin; i < end; ++i) rank.push_back(i);
+                continue;
+            }
+            const BeamState& st = beam[p];
+            rank.push_back((int32_t)moves.size());
+            moves.push_back({ p, begin < end ? -2 : -1, false });
+            assigned.push_back(st.assigned);
+            cand.weight.push_back(st.weight);
+            cand.moment.push_back(st.moment);
+            cand.deviation.push_back(st.deviation);
+        }
+        if (rank.size() > beamWidth) {
+            std::partial_sort(rank.begin(), rank.begin() + beamWidth, rank.end(), [&](int32_t a, int32_t b) {
+                if (assigned[a] != assigned[b]) return assigned[a] > assigned[b];
+                return cand.deviation[a] < cand.deviation[b];
+            });
+            rank.resize(beamWidth);
+        }
+
+        std::pmr::memory_resource* nextMem = scratch[cur ^ 1];
+        // drop the beam from two steps ago, then reuse its arena
+        std::pmr::vector<BeamState>(nextMem).swap(states[cur ^ 1]);
+        if (arena) arena->scratch[cur ^ 1].reset();
+        std::pmr::vector<BeamState>& next = states[cur ^ 1];
+        next.reserve(rank.size());
+        for (int32_t c : rank) {
+            const Move& mv = moves[c];
+            BeamState& child = next.emplace_back(nextMem);
+            child = beam[mv.parent];
+            if (mv.start >= 0) {
+                markOccupied(mv.onMain ? child.mainBits : child.lowerBits, mv.start, width);
+                child.start[ui] = mv.start;
+                child.onMain[ui] = mv.onMain;
+            }
+            else child.start[ui] = mv.start;
+            child.weight = cand.weight[c];
+            child.moment = cand.moment[c];
+            child.deviation = cand.deviation[c];
+            child.assigned = assigned[c];
+        }
+        cur ^= 1;
+    }
+
+    const BeamState& best = *std::min_element(states[cur].begin(), states[cur].end(), better);
+    for (size_t i = 0; i < ulds.size(); ++i) {
+        plan.report.push_back((int32_t)i);
+        if (best.start[i] < 0) {
+            plan.placements.push_back({ -1, widths[i], false });
+            continue;
+        }
+        placeULD(plan, ulds[i], (int)i, best.onMain[i], best.start[i], widths[i]);
+        plan.placements.push_back({ best.start[i], widths[i], (bool)best.onMain[i] });
+    }
+    if (g_metrics.enabled) {
+        // reasons are judged against the final plan
+        countEvent(Counter::PLACEMENT_ATTEMPTS, ulds.size());
+        for (size_t i = 0; i < ulds.size(); ++i) {
+            if (best.start[i] >= 0) continue;
+            countEvent(Counter::UNASSIGNED);
+            if (best.start[i] == -2) { countEvent(Counter::REJECT_MTW); continue; }
+            countRejection(plan, ulds[i], true, widths[i]);
+            countRejection(plan, ulds[i], false, widths[i]);
+        }
+    }
+    return plan;
+}
+
+// Lower-deck sequencing: the LOWER ULDs go on the lower deck in manifest order, fore to aft (each one
+// ahead of the next, the order they are rolled in), at the positions whose CG is closest to the target.
+// Dynamic programming over slot index x cumulative moment bucket: reach[j][s] is the set of moment
+// buckets the ULDs j.. can add using only slots s.., so reach[0][0] holds every achievable plan and
+// the best one is traced back from it. The buckets split the spread of achievable moments into
+// LOWER_DP_BUCKETS steps, so the CG is the best to within that resolution. Nothing is memoized across
+// flights: the run arms and start lists it reads come from the aircraft template, but the moment and
+// reach tables depend on the ULDs and are rebuilt for every flight, in its scratch arena.
+const int LOWER_DP_BUCKETS = 8192;
+
+// starts[j] for seq[j], or false if the whole sequence can't be placed on the free lower-deck slots
+bool solveLowerSequence(const LoadPlan& plan, const vector<ULD>& ulds, const std::pmr::vector<int>& seq,
+    const std::pmr::vector<int>& widths, double targetMoment, std::pmr::memory_resource* mr, std::pmr::vector<int>& starts) {
+    const DeckLayout& layout = *plan.lowerSlots.layout;
+    const int m = (int)seq.size(), n = layout.count;
+    const int words = LOWER_DP_BUCKETS / 64;
+
+    // moment of seq[j] starting at s, or NAN where it can't start
+    std::pmr::vector<double> moment((size_t)m * n, NAN, mr);
+    double base = 0.0, spread = 0.0;
+    ScopedTimer filterTimer(Phase::CANDIDATE_FILTER);
+    for (int j = 0; j < m; ++j) {
+        const ULD& u = ulds[seq[j]];
+        double lo = INFINITY, hi = -INFINITY;
+        for (int s0 : feasibleStarts(layout, widths[seq[j]], u.allowSpecialSlots)) {
+            if (!runFree(plan.lowerBits, s0, widths[seq[j]])) continue;
+            double mo = u.weight * layout.runArm[widths[seq[j]]][s0];
+            moment[(size_t)j * n + s0] = mo;
+            lo = min(lo, mo); hi = max(hi, mo);
+        }
+        if (lo > hi) return false;
+        base += lo;
+        spread += hi - lo;
+    }
+    filterTimer.stop();
+    // rounding adds at most 1/2 bucket per ULD, so leave m buckets of headroom
+    double step = spread > 0 ? spread / (LOWER_DP_BUCKETS - 1 - m) : 1.0;
+    std::pmr::vector<int32_t> bucket((size_t)m * n, -1, mr);
+    for (int j = 0; j < m; ++j) {
+        double lo = INFINITY;
+        for (int s0 = 0; s0 < n; ++s0) if (!std::isnan(moment[(size_t)j * n + s0])) lo = min(lo, moment[(size_t)j * n + s0]);
+        for (int s0 = 0; s0 < n; ++s0)
+            if (!std::isnan(moment[(size_t)j * n + s0])) bucket[(size_t)j * n + s0] = (int32_t)lround((moment[(size_t)j * n + s0] - lo) / step);
+    }
+
+    std::pmr::vector<uint64_t> reach((size_t)(m + 1) * (n + 1) * words, 0, mr);
+    auto row = [&](int j, int s0) { return reach.data() + ((size_t)j * (n + 1) + s0) * words; };
+    for (int s0 = 0; s0 <= n; ++s0) row(m, s0)[0] = 1; // nothing left to place adds no moment
+    for (int j = m - 1; j >= 0; --j) {
+        int width = widths[seq[j]];
+        for (int s0 = n - 1; s0 >= 0; --s0) {
+            uint64_t* dst = row(j, s0);
+            memcpy(dst, row(j, s0 + 1), words * sizeof(uint64_t)); // slot s0 left empty
+            int q = bucket[(size_t)j * n + s0];
+            if (q < 0) continue;
+            const uint64_t* src = row(j + 1, s0 + width); // seq[j] takes s0.., the rest go aft of it
+            int wordShift = q / 64, bitShift = q % 64;
+            for (int i = words - 1; i >= wordShift; --i) {
+                uint64_t v = src[i - wordShift] << bitShift;
+                if (bitShift && i - wordShift > 0) v |= src[i - wordShift - 1] >> (64 - bitShift);
+                dst[i] |= v;
+            }
+        }
+    }
+
+    // achievable bucket closest to the target; ties go to the lower bucket
+    double want = (targetMoment - base) / step;
+    const uint64_t* all = row(0, 0);
+    int best = -1;
+    for (int b = 0; b < LOWER_DP_BUCKETS; ++b)
+        if ((all[b / 64] >> (b % 64) & 1) && (best < 0 || fabs(b - want) < fabs(best - want))) best = b;
+    if (best < 0) return false;
+
+    // trace back, taking the foremost start that still reaches the chosen bucket
+    starts.assign(m, -1);
+    for (int j = 0, s0 = 0, b = best; j < m; ++s0) {
+        int q = bucket[(size_t)j * n + s0];
+        if (q >= 0 && q <= b) {
+            const uint64_t* rest = row(j + 1, s0 + widths[seq[j]]);
+            if (rest[(b - q) / 64] >> ((b - q) % 64) & 1) {
+                starts[j] = s0;
+                b -= q;
+                s0 += widths[seq[j]] - 1;
+                ++j;
+            }
+        }
+    }
+    return true;
+}
+
+// Main-deck and either-deck ULDs are placed first fit, as by the greedy engine; then the LOWER ULDs are
+// sequenced on the lower deck by solveLowerSequence, or placed first fit if they can't all go in order.
+// The plan stays within the MTW: a first-fit ULD that would take it over is left unassigned, and of the
+// LOWER ULDs, heaviest first as the optimizer takes them, so is each one that no longer fits. Only the
+// rest enter the sequence, so every plan the solver can pick (their weight doesn't depend on the
+// positions) is within it.
+LoadPlan planLowerSequenced(LoadPlan plan, const vector<ULD>& ulds, const ULDDB& ulddb, const PlanOptions& opts,
+    FlightArena* arena = nullptr) {
+    fillULDTable(plan.uldTable, ulds);
+    std::pmr::memory_resource* planMem = plan.report.get_allocator().resource();
+    std::pmr::memory_resource* scratch = arena ? &arena->scratch[0] : std::pmr::get_default_resource();
+
+    std::pmr::vector<int> widths(ulds.size(), planMem), seq(planMem);
+    for (int h = 0; h < (int)ulds.size(); ++h) {
+        widths[h] = max(1, getULDWidth(ulddb, ulds[h].id));
+        plan.placements.push_back({ -1, widths[h], false });
+        plan.report.push_back(h);
+    }
+    countEvent(Counter::PLACEMENT_ATTEMPTS, ulds.size());
+    double mtw = plan.tmpl->ac.mtw > 0 ? plan.tmpl->ac.mtw : INFINITY;
+    double lowerWeight = 0.0;
+    for (int h = 0; h < (int)ulds.size(); ++h) {
+        if (ulds[h].type == ULD::Type::LOWER) { seq.push_back(h); lowerWeight += ulds[h].weight; continue; }
+        if (plan.totalWeight + ulds[h].weight > mtw) {
+            countEvent(Counter::UNASSIGNED);
+            countEvent(Counter::REJECT_MTW);
+            continue;
+        }
+        plan.placements[h] = placeFirstFit(plan, ulds[h], h, widths[h]);
+    }
+
+    if (plan.totalWeight + lowerWeight > mtw) {
+        std::pmr::vector<int> heaviest(seq, scratch);
+        std::sort(heaviest.begin(), heaviest.end(), [&](int a, int b) {
+            return ulds[a].weight != ulds[b].weight ? ulds[a].weight > ulds[b].weight : a < b;
+        });
+        std::pmr::vector<char> leftOut(ulds.size(), 0, scratch);
+        lowerWeight = 0.0;
+        for (int h : heaviest) {
+            if (plan.totalWeight + lowerWeight + ulds[h].weight <= mtw) { lowerWeight += ulds[h].weight; continue; }
+            leftOut[h] = 1;
+            countEvent(Counter::UNASSIGNED);
+            countEvent(Counter::REJECT_MTW);
+        }
+        seq.erase(std::remove_if(seq.begin(), seq.end(), [&](int h) { return leftOut[h]; }), seq.end());
+    }
+
+    double target = std::isnan(opts.targetCG) ? meanSlotArm(plan) : opts.targetCG;
+    double targetMoment = target * (plan.totalWeight + lowerWeight) - plan.totalMoment;
+    std::pmr::vector<int> starts(planMem);
+    if (!seq.empty() && solveLowerSequence(plan, ulds, seq, widths, targetMoment, scratch, starts)) {
+        for (size_t j = 0; j < seq.size(); ++j) {
+            placeULD(plan, ulds[seq[j]], seq[j], false, starts[j], widths[seq[j]]);
+            plan.placements[seq[j]] = { starts[j], widths[seq[j]], false };
+        }
+    }
+    else {
+        for (int h : seq) plan.placements[h] = placeFirstFit(plan, ulds[h], h, widths[h]);
+    }
+    return plan;
+}
+
+// Plan a flight on an aircraft template, e.g. one cached per model in a TemplateCache.
+// With an arena the plan's storage lives in it: use the plan before the arena's next reset.
+LoadPlan planFlight(const shared_ptr<const AircraftTemplate>& tmpl, const vector<ULD>& ulds, const ULDDB& ulddb,
+    const PlanOptions& opts = PlanOptions(), FlightArena* arena = nullptr) {
+    ScopedTimer timer(Phase::PLACEMENT);
+    countEvent(Counter::FLIGHTS);
+    std::pmr::memory_resource* mr = arena ? &arena->plan : std::pmr::get_default_resource();
+    if (opts.engine == PlanEngine::OPTIMIZE) return planOptimized(makeEmptyPlan(tmpl, mr), ulds, ulddb, opts, arena);
+    if (opts.engine == PlanEngine::LOWER_DP) return planLowerSequenced(makeEmptyPlan(tmpl, mr), ulds, ulddb, opts, arena);
+    countEvent(tmpl->fixed ? Counter::FIXED_PATH_HITS : Counter::FIXED_PATH_MISSES);
+    if (tmpl->fixed) return tmpl->fixed->planGreedy(makeEmptyPlan(tmpl, mr), ulds, ulddb);
+    return planGreedy(makeEmptyPlan(tmpl, mr), ulds, ulddb);
+}
+
+LoadPlan planFlight(const Aircraft& aircraft, const vector<ULD>& ulds, const ULDDB& ulddb,
+    const PlanOptions& opts = PlanOptions()) {
+    return planFlight(makeAircraftTemplate(aircraft), ulds, ulddb, opts);
+}
+
+string slotLabel(const Placement& pl) {
+    return pl.start < 0 ? "UNASSIGNED" : slotLabel(pl.onMain, pl.start);
+}
+
+int countUnassigned(const LoadPlan& plan) {
+    int n = 0;
+    for (auto& pl : plan.placements) if (pl.start < 0) ++n;
+    return n;
+}
+
+void printAssignmentResults(string& out, const LoadPlan& plan) {
+    out += "\n=== Assignment Results ===\n";
+    appendPadded(out, "ULD ID", 12); appendPadded(out, "Assigned Slot", 22); appendPadded(out, "Weight(kg)", 10);
+    out += "\n";
+    out.append(46, '-');
+    out += "\n";
+    for (int32_t h : plan.report) {
+        const ULD& u = plan.uldTable.ulds[h];
+        appendPadded(out, u.id, 12); appendPadded(out, slotLabel(plan.placements[h]), 22); appendPadded(out, formatNumber(u.weight), 10);
+        out += "\n";
+    }
+    out += "Main deck: " + formatNumber(plan.deckTotals[(int)DeckId::MAIN].weight) + " kg, lower deck: "
+        + formatNumber(plan.deckTotals[(int)DeckId::LOWER].weight) + " kg\n";
+    out += "Total weight: " + formatNumber(plan.totalWeight) + " kg";
+    if (plan.totalWeight > 0) out += ", CG arm: " + formatFixed2(plan.totalMoment / plan.totalWeight);
+    out += "\n";
+    if (plan.tmpl->ac.mtw > 0 && plan.totalWeight > plan.tmpl->ac.mtw)
+        out += RED + "Warning: load exceeds MTW (" + to_string(plan.tmpl->ac.mtw) + " kg)" + RESET + "\n";
+}
+
+// ===== Interactive edits =====
+// Single-ULD place / offload / move on a finished plan. Each edit touches only the slots of the
+// ULD being moved, and the running totals in LoadPlan are updated as it goes, so a UI dragging a
+// ULD around can show the new CG after every step without re-planning.
+struct PlanEdit {
+    int32_t handle = -1;
+    Placement from, to; // start -1 = unassigned
+};
+
+struct PlanEditor {
+    LoadPlan plan;
+    vector<PlanEdit> undoStack;
+    vector<PlanEdit> redoStack;
+};
+
+double planCG(const LoadPlan& plan) {
+    return plan.totalWeight > 0 ? plan.totalMoment / plan.totalWeight : 0.0;
+}
+
+// Put ULD `handle` at `to` (start -1 = offload it). Nothing changes and false is returned if the
+// ULD's deck type, nose/tail rule or the slots already taken don't allow it.
+bool applyPlacement(LoadPlan& plan, int32_t handle, Placement to) {
+    if (handle < 0 || handle >= (int32_t)plan.placements.size()) return false;
+    const ULD& u = plan.uldTable.ulds[handle];
+    Placement& pl = plan.placements[handle];
+    to.width = pl.width;
+    if (to.start >= 0 && ((u.type == ULD::Type::MAIN && !to.onMain) || (u.type == ULD::Type::LOWER && to.onMain)))
+        return false;
+
+    Placement from = pl;
+    if (from.start >= 0) unplaceULD(plan, u, from.onMain, from.start, from.width);
+    if (to.start >= 0 && !runAvailable(to.onMain ? plan.mainBits : plan.lowerBits, to.start, to.width, u.allowSpecialSlots)) {
+        if (from.start >= 0) placeULD(plan, u, handle, from.onMain, from.start, from.width);
+        return false;
+    }
+    if (to.start >= 0) placeULD(plan, u, handle, to.onMain, to.start, to.width);
+    pl = to;
+    return true;
+}
+
+// Move (or place, if unassigned) a ULD so it starts at slot index `start` of one deck
+bool moveULD(PlanEditor& ed, int32_t handle, bool onMain, int start) {
+    if (handle < 0 || handle >= (int32_t)ed.plan.placements.size()) return false;
+    PlanEdit e{ handle, ed.plan.placements[handle], Placement{ start, 0, onMain } };
+    if (!applyPlacement(ed.plan, handle, e.to)) return false;
+    e.to = ed.plan.placements[handle];
+    ed.undoStack.push_back(e);
+    ed.redoStack.clear();
+    return true;
+}
+
+bool offloadULD(PlanEditor& ed, int32_t handle) {
+    return moveULD(ed, handle, false, -1);
+}
+
+bool undoEdit(PlanEditor& ed) {
+    if (ed.undoStack.empty()) return false;
+    PlanEdit e = ed.undoStack.back();
+    if (!applyPlacement(ed.plan, e.handle, e.from)) return false;
+    ed.undoStack.pop_back();
+    ed.redoStack.push_back(e);
+    return true;
+}
+
+bool redoEdit(PlanEditor& ed) {
+    if (ed.redoStack.empty()) return false;
+    PlanEdit e = ed.redoStack.back();
+    if (!applyPlacement(ed.plan, e.handle, e.to)) return false;
+    ed.redoStack.pop_back();
+    ed.undoStack.push_back(e);
+    return true;
+}
+
+// ===== Delta re-planning =====
+// Late manifest changes on a plan the ramp may already be loading: ULDs added, removed or re-weighed.
+// Every ULD already in place stays where it is. A re-weighed ULD keeps its position and only its
+// share of the totals changes. Added ULDs, and ULDs left unassigned before, go first fit into the
+// slots that are free now, including those a removed ULD left. Work is per changed ULD, not per
+// flight. New ULDs are placed first fit whatever engine made the plan.
+struct PlanDelta {
+    vector<ULD> added;
+    vector<string> removed;
+    vector<pair<string, double>> reweighed; // ULD ID, new weight
+};
+
+// One line of the diff between the plan before and after a delta
+struct PlanChange {
+    enum class Kind { ADDED, REMOVED, PLACED, REWEIGHED } kind = Kind::ADDED;
+    string id;
+    Placement from, to; // start -1 = unassigned
+    double weightFrom = 0.0, weightTo = 0.0;
+};
+
+// Drop the unplaced ULDs marked in `gone` in one pass, however many there are; the handles of the
+// rest move down to stay dense, and the first ULD left with an ID takes over its lookup
+void compactULDs(LoadPlan& plan, const vector<char>& gone) {
+    ULDTable& t = plan.uldTable;
+    vector<int32_t> to(t.ulds.size(), -1);
+    int32_t n = 0;
+    for (int32_t h = 0; h < (int32_t)t.ulds.size(); ++h) {
+        if (gone[h]) continue;
+        if (n != h) {
+            t.ulds[n] = std::move(t.ulds[h]);
+            plan.placements[n] = plan.placements[h];
+        }
+        to[h] = n++;
+    }
+    t.ulds.erase(t.ulds.begin() + n, t.ulds.end());
+    plan.placements.erase(plan.placements.begin() + n, plan.placements.end());
+    t.byId.clear();
+    for (int32_t h = 0; h < n; ++h) t.byId.emplace(t.ulds[h].id, h);
+    for (DeckSlots* deck : { &plan.mainSlots, &plan.lowerSlots })
+        for (auto& o : deck->occupant) if (o >= 0) o = to[o];
+    auto& r = plan.report;
+    r.erase(remove_if(r.begin(), r.end(), [&](int32_t h) { return gone[h]; }), r.end());
+    for (auto& h : r) h = to[h];
+}
+
+// Apply a delta to a plan. Every handle is resolved before anything changes: the k-th removal of
+// an ID takes the k-th ULD with that ID, and a re-weighed ID must be in the plan, have a finite weight, be
+// listed once and not also be removed. If any of that fails, nothing changes and false is
+// returned. `changes` gets the minimal diff, in the order applied.
+bool replanDelta(LoadPlan& plan, const PlanDelta& d, const ULDDB& ulddb, vector<PlanChange>& changes) {
+    ScopedTimer timer(Phase::PLACEMENT);
+    changes.clear();
+    const auto& ulds = plan.uldTable.ulds;
+    unordered_map<string, vector<int32_t>> byId; // the plan's handles for each ID named in the delta
+    for (auto& id : d.removed) byId.emplace(id, vector<int32_t>());
+    for (auto& rw : d.reweighed) byId.emplace(rw.first, vector<int32_t>());
+    for (int32_t h = 0; h < (int32_t)ulds.size(); ++h) {
+        auto it = byId.find(ulds[h].id);
+        if (it != byId.end()) it->second.push_back(h);
+    }
+    unordered_map<string, size_t> taken;
+    vector<int32_t> removed;
+    for (auto& id : d.removed) {
+        size_t k = taken[id]++;
+        if (k >= byId[id].size()) return false; // not in the plan, or removed more often than it is in it
+        removed.push_back(byId[id][k]);
+    }
+    vector<int32_t> reweighed;
+    for (auto& rw : d.reweighed) {
+        if (byId[rw.first].empty() || taken.count(rw.first) || !isfinite(rw.second)) return false;
+        taken[rw.first] = 1; // also catches a second re-weigh of the same ID
+        reweighed.push_back(byId[rw.first].front());
+    }
+
+    // Re-weighs first: they don't move handles, and the removals renumber them
+    for (size_t i = 0; i < reweighed.size(); ++i) {
+        int32_t h = reweighed[i];
+        ULD& u = plan.uldTable.ulds[h];
+        Placement pl = plan.placements[h];
+        PlanChange c{ PlanChange::Kind::REWEIGHED, u.id, pl, pl, u.weight, d.reweighed[i].second };
+        if (pl.start >= 0) unplaceULD(plan, u, pl.onMain, pl.start, pl.width);
+        u.weight = d.reweighed[i].second;
+        if (pl.start >= 0) placeULD(plan, u, h, pl.onMain, pl.start, pl.width);
+        changes.push_back(c);
+    }
+    for (int32_t h : removed)
+        changes.push_back({ PlanChange::Kind::REMOVED, ulds[h].id, plan.placements[h], Placement{}, ulds[h].weight, 0.0 });
+    // each removal only frees its slots; the table is compacted once for all of them
+    if (!removed.empty()) {
+        vector<char> gone(ulds.size(), 0);
+        for (int32_t h : removed) {
+            applyPlacement(plan, h, Placement{});
+            gone[h] = 1;
+        }
+        compactULDs(plan, gone);
+    }
+
+    // Space a removal freed may now take a ULD that didn't fit before
+    if (!d.removed.empty()) {
+        for (int32_t h : plan.report) {
+            if (plan.placements[h].start >= 0) continue;
+            const ULD& u = plan.uldTable.ulds[h];
+            Placement to = placeFirstFit(plan, u, h, plan.placements[h].width);
+            if (to.start >= 0) {
+                changes.push_back({ PlanChange::Kind::PLACED, u.id, plan.placements[h], to, u.weight, u.weight });
+                plan.placements[h] = to;
+            }
+        }
+    }
+
+    countEvent(Counter::PLACEMENT_ATTEMPTS, d.added.size());
+    for (const ULD& u : d.added) {
+        int32_t h = (int32_t)plan.uldTable.ulds.size();
+        plan.uldTable.ulds.push_back(u);
+        plan.uldTable.byId.emplace(u.id, h);
+        int width = max(1, getULDWidth(ulddb, u.id));
+        plan.report.push_back(h);
+        plan.placements.push_back(placeFirstFit(plan, u, h, width));
+        changes.push_back({ PlanChange::Kind::ADDED, u.id, Placement{}, plan.placements[h], 0.0, u.weight });
+    }
+    return true;
+}
+
+void printPlanDelta(string& out, const LoadPlan& plan, const vector<PlanChange>& changes) {
+    out += "\n=== Plan Changes ===\n";
+    for (auto& c : changes) {
+        switch (c.kind) {
+        case PlanChange::Kind::ADDED:
+            out += "  added     " + c.id + " -> " + slotLabel(c.to) + " (" + formatNumber(c.weightTo) + " kg)\n"; break;
+        case PlanChange::Kind::REMOVED:
+            out += "  removed   " + c.id + " from " + slotLabel(c.from) + "\n"; break;
+        case PlanChange::Kind::PLACED:
+            out += "  placed    " + c.id + " -> " + slotLabel(c.to) + "\n"; break;
+        case PlanChange::Kind::REWEIGHED:
+            out += "  reweighed " + c.id + " at " + slotLabel(c.to) + ": " + formatNumber(c.weightFrom) + " -> " +
+                formatNumber(c.weightTo) + " kg\n"; break;
+        }
+    }
+    if (changes.empty()) out += "  none\n";
+    out += "All other ULDs stay in place. Total weight: " + formatNumber(plan.totalWeight) + " kg, CG arm: " +
+        formatFixed2(planCG(plan)) + "\n";
+    if (plan.tmpl->ac.mtw > 0 && plan.totalWeight > plan.tmpl->ac.mtw)
+        out += RED + "Warning: load exceeds MTW (" + to_string(plan.tmpl->ac.mtw) + " kg)" + RESET + "\n";
+}
+
+// ===== What-if evaluation =====
+struct Perturbation {
+    enum class Kind { SWAP, OFFLOAD } kind = Kind::OFFLOAD;
+    string uldA; // ULD to offload, or first ULD of a swap
+    string uldB; // second ULD of a swap
+};
+
+struct WhatIfResult {
+    string label;
+    bool feasible = true;
+    double totalWeight = 0.0;
+    double totalMoment = 0.0;
+    double cg = 0.0;
+    int assigned = 0;
+    int unassigned = 0;
+};
+
+string describePerturbation(const Perturbation& p) {
+    return p.kind == Perturbation::Kind::SWAP ? "swap " + p.uldA + " <-> " + p.uldB : "offload " + p.uldA;
+}
+
+// Score one variant of the base plan. Only the occupancy bitmaps and placement list are copied;
+// the base plan's slot arrays are shared read-only between all workers.
+WhatIfResult evaluateWhatIf(const LoadPlan& base, const Perturbation& p) {
+    const auto& ulds = base.uldTable.ulds;
+    WhatIfResult r;
+    r.label = describePerturbation(p);
+    r.totalWeight = base.totalWeight;
+    r.totalMoment = base.totalMoment;
+    for (auto& pl : base.placements) pl.start >= 0 ? r.assigned++ : r.unassigned++;
+
+    int a = findULD(base.uldTable, p.uldA);
+    if (a < 0) { r.feasible = false; return r; }
+    const Placement& pa = base.placements[a];
+    auto moment = [&](int i, const Placement& pl) {
+        return ulds[i].weight * runArm(pl.onMain ? base.mainSlots : base.lowerSlots, pl.start, pl.width);
+    };
+
+    if (p.kind == Perturbation::Kind::OFFLOAD) {
+        if (pa.start >= 0) {
+            r.assigned--;
+            r.totalWeight -= ulds[a].weight;
+            r.totalMoment -= moment(a, pa);
+        }
+        else r.unassigned--;
+    }
+    else {
+        int b = findULD(base.uldTable, p.uldB);
+        if (b < 0 || base.placements[a].start < 0 || base.placements[b].start < 0) {
+            r.feasible = false; return r;
+        }
+        const Placement& pb = base.placements[b];
+
+        DeckBitmap mainBits = base.mainBits, lowerBits = base.lowerBits;
+        clearOccupied(pa.onMain ? mainBits : lowerBits, pa.start, pa.width);
+        clearOccupied(pb.onMain ? mainBits : lowerBits, pb.start, pb.width);
+
+        // each ULD tries the other's first slot, on the other's deck
+        auto fits = [&](int i, const Placement& at) {
+            const ULD& u = ulds[i];
+            if ((u.type == ULD::Type::MAIN && !at.onMain) || (u.type == ULD::Type::LOWER && at.onMain)) return false;
+            return runAvailable(at.onMain ? mainBits : lowerBits, at.start, base.placements[i].width, u.allowSpecialSlots);
+        };
+        Placement na{ pb.start, pa.width, pb.onMain }, nb{ pa.start, pb.width, pa.onMain };
+        if (!fits(a, na)) { r.feasible = false; return r; }
+        markOccupied(na.onMain ? mainBits : lowerBits, na.start, na.width);
+        if (!fits(b, nb)) { r.feasible = false; return r; }
+
+        r.totalMoment += moment(a, na) + moment(b, nb) - moment(a, pa) - moment(b, pb);
+    }
+
+    r.cg = r.totalWeight > 0 ? r.totalMoment / r.totalWeight : 0.0;
+    return r;
+}
+
+// Score every perturbation of the base plan in parallel; results come back in input order
+vector<WhatIfResult> evaluateWhatIfs(const LoadPlan& base,
+    const vector<Perturbation>& perturbations, unsigned threads = 0) {
+    vector<WhatIfResult> results(perturbations.size());
+    parallelFor(perturbations.size(), threads,
+        [&](size_t i) { results[i] = evaluateWhatIf(base, perturbations[i]); });
+    return results;
+}
+
+void printWhatIfResults(string& out, const vector<WhatIfResult>& results) {
+    out += "\n=== What-if Results ===\n";
+    appendPadded(out, "Variant", 32); appendPadded(out, "Weight(kg)", 12); appendPadded(out, "CG arm", 10); appendPadded(out, "Assigned", 10);
+    out += "Unassigned\n";
+    out.append(74, '-');
+    out += "\n";
+    for (auto& r : results) {
+        appendPadded(out, r.label, 32);
+        if (!r.feasible) { out += "not feasible\n"; continue; }
+        appendPadded(out, formatNumber(r.totalWeight), 12); appendPadded(out, formatFixed2(r.cg), 10);
+        appendPadded(out, to_string(r.assigned), 10);
+        out += to_string(r.unassigned) + "\n";
+    }
+}
+
+// ===== Batch mode =====
+struct FlightManifest {
+    string flightId;
+    string model;
+    vector<ULD> ulds;
+    vector<Perturbation> whatIfs;
+};
+
+// Reads one flight object of a JSON manifest (or server request); throws on mistyped fields
+void parseFlightJSON(const json& entry, FlightManifest& f) {
+    f.flightId = entry.value("flight", "");
+    f.model = entry.value("model", "");
+    if (entry.contains("ulds") && entry["ulds"].is_array()) {
+        for (auto& ju : entry["ulds"]) {
+            ULD u;
+            u.id = ju.value("id", "");
+            u.weight = ju.value("weight", 0.0);
+            u.type = parseULDType(ju.value("type", "ANY"));
+            u.allowSpecialSlots = ju.value("allowSpecialSlots", true);
+            if (!u.id.empty()) f.ulds.push_back(u);
+        }
+    }
+    if (entry.contains("whatIf") && entry["whatIf"].is_array()) {
+        for (auto& jw : entry["whatIf"]) {
+            Perturbation p;
+            if (jw.contains("swap") && jw["swap"].is_array() && jw["swap"].size() == 2 &&
+                jw["swap"][0].is_string() && jw["swap"][1].is_string()) {
+                p.kind = Perturbation::Kind::SWAP;
+                p.uldA = jw["swap"][0].get<string>();
+                p.uldB = jw["swap"][1].get<string>();
+            }
+            else if (jw.contains("offload")) {
+                p.uldA = jw.value("offload", "");
+            }
+            else continue;
+            f.whatIfs.push_back(p);
+        }
+    }
+}
+
+// JSON manifest: [{"flight": "XX123", "model": "A330-200",
+//                  "ulds": [{"id": "PMC12345XX", "weight": 1200, "type": "MAIN", "allowSpecialSlots": true}],
+//                  "whatIf": [{"swap": ["PMC12345XX", "PMC23456XX"]}, {"offload": "AKE34567XX"}]}]
+// A top-level object with a "flights" array is accepted as well. "whatIf" is optional.
+// Read with the SAX interface: only the flight currently being read is held as a DOM, so memory
+// stays flat however large the manifest is, and each flight is handed on as soon as it closes.
+class ManifestSax : public nlohmann::json_sax<json> {
+public:
+    explicit ManifestSax(const function<void(FlightManifest&&)>& onFlight) : onFlight(onFlight) {}
+
+    bool null() override { return add(json()); }
+    bool boolean(bool v) override { return add(json(v)); }
+    bool number_integer(number_integer_t v) override { return add(json(v)); }
+    bool number_unsigned(number_unsigned_t v) override { return add(json(v)); }
+    bool number_float(number_float_t v, const string_t&) override { return add(json(v)); }
+    bool string(string_t& v) override { return add(json(std::move(v))); }
+    bool binary(binary_t&) override { return add(json()); }
+
+    bool start_object(size_t) override {
+        if (!building.empty() || depth == flightsDepth) { building.push_back(json::object()); keys.emplace_back(); }
+        ++depth;
+        return true;
+    }
+    bool key(string_t& k) override {
+        if (!building.empty()) keys.back() = k;
+        else if (depth == 1) rootKey = k;
+        return true;
+    }
+    bool end_object() override {
+        --depth;
+        if (!building.empty()) return close();
+        return true;
+    }
+    bool start_array(size_t) override {
+        if (!building.empty()) { building.push_back(json::array()); keys.emplace_back(); }
+        else if (depth == 0) flightsDepth = 1;                          // [ {flight}, ... ]
+        else if (depth == 1 && rootKey == "flights") flightsDepth = 2;  // {"flights": [ {flight}, ... ]}
+        ++depth;
+        return true;
+    }
+    bool end_array() override {
+        --depth;
+        if (!building.empty()) return close();
+        if (depth == flightsDepth - 1) flightsDepth = -1; // end of the flights array
+        return true;
+    }
+    bool parse_error(size_t, const std::string&, const nlohmann::detail::exception&) override { return false; }
+
+    size_t delivered = 0;
+
+private:
+    // Attach a finished value to the container being built; values outside a flight are dropped
+    bool add(json&& v) {
+        if (building.empty()) return true;
+        json& top = building.back();
+        if (top.is_object()) top[keys.back()] = std::move(v);
+        else top.push_back(std::move(v));
+        return true;
+    }
+    bool close() {
+        json done = std::move(building.back());
+        building.pop_back();
+        keys.pop_back();
+        if (!building.empty()) return add(std::move(done));
+
+        FlightManifest f;
+        try { parseFlightJSON(done, f); }
+        catch (...) { return true; }
+        if (f.flightId.empty()) f.flightId = "FLIGHT" + to_string(delivered + 1);
+        ++delivered;
+        onFlight(std::move(f));
+        return true;
+    }
+
+    const function<void(FlightManifest&&)>& onFlight;
+    vector<json> building;   // containers of the flight being read, outermost first
+    vector<std::string> keys; // pending key per object in `building`
+    std::string rootKey;
+    int depth = 0;
+    int flightsDepth = -1;   // container depth at which flight objects sit
+};
+
+// Calls onFlight for each flight as it is read. Returns false if the file can't be opened or
+// stops being valid JSON; flights before the error have already been delivered.
+bool streamManifestJSON(const std::string& path, const function<void(FlightManifest&&)>& onFlight) {
+    ifstream in(path, ios::binary);
+    if (!in) return false;
+    ManifestSax sax(onFlight);
+    try { return json::sax_parse(in, &sax); }
+    catch (...) { return false; }
+}
+
+// CSV manifest, one ULD per row (header row optional):
+//   flight,model,uld_id,weight,type,allow_special
+// Rows are grouped by flight in order of first appearance.
+vector<FlightManifest> loadManifestCSV(const string& path) {
+    vector<FlightManifest> flights;
+    ifstream in(path);
+    if (!in) return flights;
+
+    map<string, size_t> flightIndex;
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+
+        vector<string> fields;
+        stringstream ss(line);
+        string field;
+        while (getline(ss, field, ',')) fields.push_back(field);
+        if (fields.size() < 4 || fields[0] == "flight") continue;
+
+        ULD u;
+        u.id = fields[2];
+        try { u.weight = stod(fields[3]); }
+        catch (...) { continue; }
+        if (fields.size() > 4) u.type = parseULDType(fields[4]);
+        if (fields.size() > 5 && !fields[5].empty()) u.allowSpecialSlots = parseYesNo(fields[5]);
+        if (u.id.empty()) continue;
+
+        auto it = flightIndex.find(fields[0]);
+        if (it == flightIndex.end()) {
+            FlightManifest f;
+            f.flightId = fields[0];
+            f.model = fields[1];
+            it = flightIndex.emplace(fields[0], flights.size()).first;
+            flights.push_back(f);
+        }
+        flights[it->second].ulds.push_back(u);
+    }
+    return flights;
+}
+
+// JSON manifests are streamed; CSV rows of one flight may be spread over the file, so a CSV
+// manifest is read whole and then handed on flight by flight.
+bool streamManifest(const string& path, const function<void(FlightManifest&&)>& onFlight) {
+    string ext = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext != ".csv") return streamManifestJSON(path, onFlight);
+    for (auto& f : loadManifestCSV(path)) onFlight(std::move(f));
+    return true;
+}
+
+// Fixed-capacity hand-off from the manifest reader thread to the planners; flights are numbered
+// in manifest order as they are pushed
+struct FlightQueue {
+    mutex m;
+    condition_variable notFull, notEmpty;
+    deque<pair<size_t, FlightManifest>> items;
+    size_t capacity = 64;
+    size_t pushed = 0;
+    bool closed = false;
+};
+
+void pushFlight(FlightQueue& q, FlightManifest&& f) {
+    unique_lock<mutex> lock(q.m);
+    q.notFull.wait(lock, [&] { return q.items.size() < q.capacity; });
+    q.items.emplace_back(q.pushed++, std::move(f));
+    q.notEmpty.notify_one();
+}
+
+// false once the queue is closed and drained
+bool popFlight(FlightQueue& q, FlightManifest& f, size_t& seq) {
+    unique_lock<mutex> lock(q.m);
+    q.notEmpty.wait(lock, [&] { return !q.items.empty() || q.closed; });
+    if (q.items.empty()) return false;
+    seq = q.items.front().first;
+    f = std::move(q.items.front().second);
+    q.items.pop_front();
+    q.notFull.notify_one();
+    return true;
+}
+
+void closeQueue(FlightQueue& q) {
+    lock_guard<mutex> lock(q.m);
+    q.closed = true;
+    q.notEmpty.notify_all();
+}
+
+// ===== Structured output =====
+// Machine-readable alternatives to the text blocks, for systems downstream: one JSON line per flight,
+// or one binary record per flight for high-volume archives. Each flight's output is built in one
+// buffer and written with a single write.
+json planToJSON(const FlightManifest& f, const LoadPlan& plan) {
+    json r;
+    r["flight"] = f.flightId;
+    r["model"] = f.model;
+    json assignments = json::array();
+    for (int32_t h : plan.report) {
+        const ULD& u = plan.uldTable.ulds[h];
+        assignments.push_back({ {"id", u.id}, {"slot", slotLabel(plan.placements[h])}, {"weight", u.weight} });
+    }
+    r["assignments"] = assignments;
+    r["unassigned"] = countUnassigned(plan);
+    r["totalWeight"] = plan.totalWeight;
+    r["totalMoment"] = plan.totalMoment;
+    r["cg"] = plan.totalWeight > 0 ? plan.totalMoment / plan.totalWeight : 0.0;
+    r["mainDeckWeight"] = deckWeight(plan.mainSlots);
+    r["lowerDeckWeight"] = deckWeight(plan.lowerSlots);
+    r["overMTW"] = plan.tmpl->ac.mtw > 0 && plan.totalWeight > plan.tmpl->ac.mtw;
+    return r;
+}
+
+json whatIfsToJSON(const vector<WhatIfResult>& results) {
+    json variants = json::array();
+    for (auto& r : results) {
+        variants.push_back({ {"variant", r.label}, {"feasible", r.feasible}, {"totalWeight", r.totalWeight},
+            {"cg", r.cg}, {"assigned", r.assigned}, {"unassigned", r.unassigned} });
+    }
+    return variants;
+}
+
+// Per slot: the occupant's ID and its share of the weight, or null if empty
+json occupancyToJSON(const LoadPlan& plan, const DeckSlots& deck) {
+    json slots = json::array();
+    for (int i = 0; i < deck.layout->count; ++i) {
+        if (deck.occupant[i] < 0) slots.push_back(nullptr);
+        else slots.push_back({ {"id", plan.uldTable.ulds[deck.occupant[i]].id}, {"weight", deck.occupantWeight[i]} });
+    }
+    return slots;
+}
+
+// One JSON line: the server's response fields plus per-slot occupancy and any what-if scores
+void appendPlanJSONLine(string& out, const FlightManifest& f, const LoadPlan& plan, const vector<WhatIfResult>& whatIfs) {
+    json r = planToJSON(f, plan);
+    r["occupancy"] = { {"main", occupancyToJSON(plan, plan.mainSlots)}, {"lower", occupancyToJSON(plan, plan.lowerSlots)} };
+    if (!whatIfs.empty()) r["whatIf"] = whatIfsToJSON(whatIfs);
+    out += r.dump();
+    out += '\n';
+}
+
+// Binary plan record, in host byte order like the DB image, every part 8-byte aligned:
+// header | ULD records (manifest order) | slot occupants (int32 handle, -1 = empty; main deck, then
+// lower) | string bytes (flight, model, ULD IDs), zero-padded to a multiple of 8
+const char* const PLAN_RECORD_MAGIC = "LCPR";
+const uint32_t PLAN_RECORD_VERSION = 1;
+const uint32_t PLAN_RECORD_OVER_MTW = 1;
+
+struct PlanRecordHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t recordBytes; // whole record, header included
+    uint32_t uldCount;
+    uint32_t mainSlots, lowerSlots;
+    uint32_t flightOffset, flightLength; // into the string bytes
+    uint32_t modelOffset, modelLength;
+    uint32_t unassigned;
+    uint32_t flags;
+    double totalWeight, totalMoment, cg, mainWeight, lowerWeight;
+};
+
+struct PlanRecordULD {
+    double weight;
+    uint32_t idOffset, idLength;
+    int32_t start; // -1 = unassigned
+    uint16_t width;
+    uint8_t onMain;
+    uint8_t type; // ULD::Type
+};
+
+void appendPlanRecord(string& out, const FlightManifest& f, const LoadPlan& plan) {
+    const auto& ulds = plan.uldTable.ulds;
+    string strings;
+    auto addString = [&](const string& v, uint32_t& offset, uint32_t& length) {
+        offset = (uint32_t)strings.size();
+        length = (uint32_t)v.size();
+        strings += v;
+    };
+
+    PlanRecordHeader h{};
+    memcpy(h.magic, PLAN_RECORD_MAGIC, 4);
+    h.version = PLAN_RECORD_VERSION;
+    h.uldCount = (uint32_t)ulds.size();
+    h.mainSlots = (uint32_t)plan.mainSlots.layout->count;
+    h.lowerSlots = (uint32_t)plan.lowerSlots.layout->count;
+    addString(f.flightId, h.flightOffset, h.flightLength);
+    addString(f.model, h.modelOffset, h.modelLength);
+    h.unassigned = (uint32_t)countUnassigned(plan);
+    h.flags = plan.tmpl->ac.mtw > 0 && plan.totalWeight > plan.tmpl->ac.mtw ? PLAN_RECORD_OVER_MTW : 0;
+    h.totalWeight = plan.totalWeight;
+    h.totalMoment = plan.totalMoment;
+    h.cg = plan.totalWeight > 0 ? plan.totalMoment / plan.totalWeight : 0.0;
+    h.mainWeight = deckWeight(plan.mainSlots);
+    h.lowerWeight = deckWeight(plan.lowerSlots);
+
+    vector<PlanRecordULD> recs(ulds.size());
+    for (size_t i = 0; i < ulds.size(); ++i) {
+        const Placement& pl = plan.placements[i];
+        recs[i].weight = ulds[i].weight;
+        addString(ulds[i].id, recs[i].idOffset, recs[i].idLength);
+        recs[i].start = pl.start;
+        recs[i].width = (uint16_t)pl.width;
+        recs[i].onMain = pl.onMain;
+        recs[i].type = (uint8_t)ulds[i].type;
+    }
+    size_t slotCount = h.mainSlots + h.lowerSlots;
+    size_t slotBytes = (slotCount * sizeof(int32_t) + 7) / 8 * 8;
+    strings.resize((strings.size() + 7) / 8 * 8, '\0');
+    h.recordBytes = (uint32_t)(sizeof(h) + recs.size() * sizeof(PlanRecordULD) + slotBytes + strings.size());
+
+    size_t at = out.size();
+    out.resize(at + h.recordBytes, '\0');
+    char* p = &out[at];
+    memcpy(p, &h, sizeof(h)); p += sizeof(h);
+    if (!recs.empty()) memcpy(p, recs.data(), recs.size() * sizeof(PlanRecordULD));
+    p += recs.size() * sizeof(PlanRecordULD);
+    for (const DeckSlots* deck : { &plan.mainSlots, &plan.lowerSlots }) {
+        memcpy(p, deck->occupant.data(), deck->occupant.size() * sizeof(int32_t));
+        p += deck->occupant.size() * sizeof(int32_t);
+    }
+    p = &out[at] + h.recordBytes - strings.size();
+    memcpy(p, strings.data(), strings.size());
+}
+
+// ===== Plan archive =====
+// Every issued plan, kept for audit: an append-only segment file of binary plan records and, next to
+// it, an index of fixed-size entries by flight, aircraft and issue date. Both are read through mmap,
+// so queries and the "compare with last issued plan" check never reparse text. The segment alone is
+// enough to rebuild the index, so a crash between the two writes is repaired on the next open.
+// Segment: header | (ArchiveRecordPrefix | plan record)...   Index: header | ArchiveIndexEntry...
+const char* const ARCHIVE_SEGMENT_MAGIC = "LCAS";
+const char* const ARCHIVE_INDEX_MAGIC = "LCAI";
+const uint32_t ARCHIVE_VERSION = 1;
+
+struct ArchiveFileHeader {
+    char magic[4];
+    uint32_t version;
+};
+
+struct ArchiveRecordPrefix {
+    int64_t issuedAt; // unix seconds
+    uint32_t recordBytes;
+    uint32_t reserved;
+};
+
+struct ArchiveIndexEntry {
+    uint64_t offset; // of the plan record in the segment
+    uint32_t recordBytes;
+    uint32_t date; // yyyymmdd, UTC
+    int64_t issuedAt;
+    uint64_t flightHash, modelHash;
+};
+
+static_assert(sizeof(PlanRecordHeader) == 88 && sizeof(PlanRecordULD) == 24 && sizeof(ArchiveFileHeader) == 8 &&
+    sizeof(ArchiveRecordPrefix) == 16 && sizeof(ArchiveIndexEntry) == 40, "archive records must not be padded");
+
+// A plan record checked against the bytes it sits in
+struct PlanRecordView {
+    const PlanRecordHeader* header = nullptr;
+    const PlanRecordULD* ulds = nullptr;
+    const int32_t* occupants = nullptr; // main deck, then lower
+    const char* strings = nullptr;
+    uint32_t stringBytes = 0;
+};
+
+bool viewPlanRecord(const char* p, size_t avail, PlanRecordView& v) {
+    if (avail < sizeof(PlanRecordHeader)) return false;
+    const auto* h = (const PlanRecordHeader*)p;
+    if (memcmp(h->magic, PLAN_RECORD_MAGIC, 4) != 0 || h->version != PLAN_RECORD_VERSION || h->recordBytes > avail) return false;
+    uint64_t slotBytes = ((uint64_t)(h->mainSlots + (uint64_t)h->lowerSlots) * sizeof(int32_t) + 7) / 8 * 8;
+    uint64_t fixed = sizeof(PlanRecordHeader) + (uint64_t)h->uldCount * sizeof(PlanRecordULD) + slotBytes;
+    if (fixed > h->recordBytes) return false;
+    v.header = h;
+    v.ulds = (const PlanRecordULD*)(p + sizeof(PlanRecordHeader));
+    v.occupants = (const int32_t*)(p + sizeof(PlanRecordHeader) + h->uldCount * sizeof(PlanRecordULD));
+    v.strings = p + fixed;
+    v.stringBytes = (uint32_t)(h->recordBytes - fixed);
+    return true;
+}
+
+string recordString(const PlanRecordView& v, uint32_t offset, uint32_t length) {
+    return offset + (uint64_t)length <= v.stringBytes ? string(v.strings + offset, length) : string();
+}
+
+uint64_t hashString(const string& s) { return hashBytes(s.data(), s.size()); }
+
+// Days since 1970-01-01 to a civil date (proleptic Gregorian), without the C library's time zone state
+void civilFromDays(int64_t days, int& y, int& m, int& d) {
+    days += 719468;
+    int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    int64_t doe = days - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    y = (int)(yoe + era * 400 + (m <= 2));
+}
+
+int64_t floorDiv(int64_t a, int64_t b) { return a / b - (a % b != 0 && (a < 0) != (b < 0)); }
+
+uint32_t archiveDate(int64_t issuedAt) {
+    int y, m, d;
+    civilFromDays(floorDiv(issuedAt, 86400), y, m, d);
+    return (uint32_t)(y * 10000 + m * 100 + d);
+}
+
+// "2024-05-01 14:30 UTC"
+string formatIssued(int64_t issuedAt) {
+    int y, m, d;
+    civilFromDays(floorDiv(issuedAt, 86400), y, m, d);
+    int64_t secs = issuedAt - floorDiv(issuedAt, 86400) * 86400;
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%04d-%02d-%02d %02d:%02d UTC", y, m, d, (int)(secs / 3600), (int)(secs / 60 % 60));
+    return buf;
+}
+
+// "YYYY-MM-DD" to yyyymmdd
+bool parseArchiveDate(const string& s, uint32_t& date) {
+    int y, m, d;
+    char tail;
+    if (sscanf(s.c_str(), "%4d-%2d-%2d%c", &y, &m, &d, &tail) != 3 || m < 1 || m > 12 || d < 1 || d > 31) return false;
+    date = (uint32_t)(y * 10000 + m * 100 + d);
+    return true;
+}
+
+string archiveIndexPath(const string& segmentPath) { return segmentPath + ".idx"; }
+
+bool hasArchiveHeader(const MappedFile& m, const char* magic) {
+    if (m.size < sizeof(ArchiveFileHeader)) return false;
+    const auto& h = *(const ArchiveFileHeader*)m.data;
+    return memcmp(h.magic, magic, 4) == 0 && h.version == ARCHIVE_VERSION;
+}
+
+ArchiveIndexEntry makeIndexEntry(uint64_t offset, const PlanRecordView& v, int64_t issuedAt) {
+    ArchiveIndexEntry e{};
+    e.offset = offset;
+    e.recordBytes = v.header->recordBytes;
+    e.issuedAt = issuedAt;
+    e.date = archiveDate(issuedAt);
+    e.flightHash = hashString(recordString(v, v.header->flightOffset, v.header->flightLength));
+    e.modelHash = hashString(recordString(v, v.header->modelOffset, v.header->modelLength));
+    return e;
+}
+
+// Walk the segment's records from end (just past the last known one), adding an index entry for each
+// intact record; returns the end of the last one
+uint64_t scanArchiveRecords(const MappedFile& seg, uint64_t end, vector<ArchiveIndexEntry>& entries) {
+    while (end + sizeof(ArchiveRecordPrefix) <= seg.size) {
+        const auto& prefix = *(const ArchiveRecordPrefix*)(seg.data + end);
+        PlanRecordView v;
+        uint64_t at = end + sizeof(ArchiveRecordPrefix);
+        if (!viewPlanRecord(seg.data + at, seg.size - at, v) || v.header->recordBytes != prefix.recordBytes) break;
+        entries.push_back(makeIndexEntry(at, v, prefix.issuedAt));
+        end = at + prefix.recordBytes;
+    }
+    return end;
+}
+
+// Appends plans to an archive; one writer per archive at a time
+struct ArchiveWriter {
+    ofstream segment, index;
+    uint64_t segmentBytes = 0;
+};
+
+// Bring the index in line with the segment before appending: entries for records past the last
+// indexed one are rebuilt from the segment, and a record cut short by a crash is dropped
+bool repairArchive(const string& segmentPath, uint64_t& segmentBytes) {
+    string indexPath = archiveIndexPath(segmentPath);
+    ArchiveFileHeader header{};
+    header.version = ARCHIVE_VERSION;
+    MappedFile seg, idx;
+    if (!mapFile(segmentPath, seg)) {
+        if (ifstream(segmentPath) && ifstream(segmentPath, ios::ate).tellg() > 0) return false; // exists but unreadable
+        memcpy(header.magic, ARCHIVE_SEGMENT_MAGIC, 4);
+        ofstream s(segmentPath, ios::binary | ios::trunc);
+        s.write((const char*)&header, sizeof(header));
+        memcpy(header.magic, ARCHIVE_INDEX_MAGIC, 4);
+        ofstream i(indexPath, ios::binary | ios::trunc);
+        i.write((const char*)&header, sizeof(header));
+        segmentBytes = sizeof(header);
+        return (bool)s && (bool)i;
+    }
+    if (!hasArchiveHeader(seg, ARCHIVE_SEGMENT_MAGIC)) return false;
+
+    // Keep index entries while they describe consecutive records of the segment
+    vector<ArchiveIndexEntry> entries;
+    uint64_t end = sizeof(ArchiveFileHeader);
+    bool indexOk = mapFile(indexPath, idx) && hasArchiveHeader(idx, ARCHIVE_INDEX_MAGIC);
+    if (indexOk) {
+        const auto* e = (const ArchiveIndexEntry*)(idx.data + sizeof(ArchiveFileHeader));
+        size_t n = (idx.size - sizeof(ArchiveFileHeader)) / sizeof(ArchiveIndexEntry);
+        for (size_t k = 0; k < n && e[k].offset == end + sizeof(ArchiveRecordPrefix) &&
+            e[k].offset + e[k].recordBytes <= seg.size; ++k) {
+            entries.push_back(e[k]);
+            end = e[k].offset + e[k].recordBytes;
+        }
+        indexOk = entries.size() == n && idx.size == sizeof(ArchiveFileHeader) + n * sizeof(ArchiveIndexEntry);
+    }
+    size_t indexed = entries.size();
+    end = scanArchiveRecords(seg, end, entries);
+    bool rebuilt = entries.size() > indexed;
+    bool truncated = end != seg.size;
+    unmapFile(seg);
+    unmapFile(idx);
+
+    if (truncated) {
+        error_code ec;
+        filesystem::resize_file(segmentPath, end, ec);
+        if (ec) return false;
+        cerr << RED << "Archive " << segmentPath << ": dropped an incomplete record at the end" << RESET << "\n";
+    }
+    if (!indexOk || rebuilt) {
+        memcpy(header.magic, ARCHIVE_INDEX_MAGIC, 4);
+        ofstream i(indexPath, ios::binary | ios::trunc);
+        i.write((const char*)&header, sizeof(header));
+        if (!entries.empty()) i.write((const char*)entries.data(), entries.size() * sizeof(ArchiveIndexEntry));
+        if (!i) return false;
+    }
+    segmentBytes = end;
+    return true;
+}
+
+bool openArchiveWriter(const string& segmentPath, ArchiveWriter& w) {
+    if (!repairArchive(segmentPath, w.segmentBytes)) {
+        cout << RED << "Archive " << segmentPath << " is not a plan archive or can't be repaired." << RESET << "\n";
+        return false;
+    }
+    w.segment.open(segmentPath, ios::binary | ios::app);
+    w.index.open(archiveIndexPath(segmentPath), ios::binary | ios::app);
+    return w.segment.is_open() && w.index.is_open();
+}
+
+// Segment first, then the index entry, each flushed, so the index never points past the segment
+bool archivePlanRecord(ArchiveWriter& w, const string& record, int64_t issuedAt) {
+    PlanRecordView v;
+    if (!w.segment.is_open() || !viewPlanRecord(record.data(), record.size(), v)) return false;
+    ScopedTimer timer(Phase::SAVE);
+    ArchiveRecordPrefix prefix{ issuedAt, (uint32_t)record.size(), 0 };
+    w.segment.write((const char*)&prefix, sizeof(prefix));
+    w.segment.write(record.data(), record.size());
+    w.segment.flush();
+    ArchiveIndexEntry e = makeIndexEntry(w.segmentBytes + sizeof(prefix), v, issuedAt);
+    w.index.write((const char*)&e, sizeof(e));
+    w.index.flush();
+    w.segmentBytes += sizeof(prefix) + record.size();
+    return (bool)w.segment && (bool)w.index;
+}
+
+int64_t unixNow() {
+    return chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Read side: both files mapped; entries are checked against the segment as they are used. Records
+// the index doesn't cover (index missing or damaged, or a writer stopped between the segment and the
+// index) are found by walking the segment, as repairArchive does, into an index in memory; the
+// files are left alone for the next writer to repair.
+struct PlanArchive {
+    MappedFile segment, index;
+    const ArchiveIndexEntry* entries = nullptr;
+    size_t count = 0;
+    vector<ArchiveIndexEntry> scanned; // entries, when they aren't all in the index file
+};
+
+bool openArchive(const string& segmentPath, PlanArchive& a) {
+    if (!mapFile(segmentPath, a.segment) || !hasArchiveHeader(a.segment, ARCHIVE_SEGMENT_MAGIC)) return false;
+    uint64_t end = sizeof(ArchiveFileHeader);
+    if (mapFile(archiveIndexPath(segmentPath), a.index) && hasArchiveHeader(a.index, ARCHIVE_INDEX_MAGIC)) {
+        a.entries = (const ArchiveIndexEntry*)(a.index.data + sizeof(ArchiveFileHeader));
+        a.count = (a.index.size - sizeof(ArchiveFileHeader)) / sizeof(ArchiveIndexEntry);
+        if (a.count) end = a.entries[a.count - 1].offset + a.entries[a.count - 1].recordBytes;
+    }
+    if (end < a.segment.size) {
+        a.scanned.assign(a.entries, a.entries + a.count);
+        scanArchiveRecords(a.segment, end, a.scanned);
+        a.entries = a.scanned.data();
+        a.count = a.scanned.size();
+    }
+    return true;
+}
+
+bool viewArchived(const PlanArchive& a, const ArchiveIndexEntry& e, PlanRecordView& v) {
+    return e.offset + e.recordBytes <= a.segment.size && viewPlanRecord(a.segment.data + e.offset, e.recordBytes, v);
+}
+
+// Empty fields match everything
+struct ArchiveFilter {
+    string flight, model;
+    uint32_t date = 0;
+};
+
+bool matchesFilter(const PlanArchive& a, const ArchiveIndexEntry& e, const ArchiveFilter& f, PlanRecordView& v) {
+    if (f.date && e.date != f.date) return false;
+    if (!f.flight.empty() && e.flightHash != hashString(f.flight)) return false;
+    if (!f.model.empty() && e.modelHash != hashString(f.model)) return false;
+    if (!viewArchived(a, e, v)) return false;
+    // hashes narrow it down, the record's strings decide
+    return (f.flight.empty() || recordString(v, v.header->flightOffset, v.header->flightLength) == f.flight) &&
+        (f.model.empty() || recordString(v, v.header->modelOffset, v.header->modelLength) == f.model);
+}
+
+// The most recent plan issued for this flight and model
+bool findLastIssued(const PlanArchive& a, const string& flight, const string& model, PlanRecordView& v, int64_t& issuedAt) {
+    ArchiveFilter f{ flight, model, 0 };
+    for (size_t k = a.count; k-- > 0;) {
+        if (matchesFilter(a, a.entries[k], f, v)) { issuedAt = a.entries[k].issuedAt; return true; }
+    }
+    return false;
+}
+
+// --archive-query: one line per matching plan, in issue order
+int runArchiveQuery(const string& segmentPath, const ArchiveFilter& filter) {
+    PlanArchive a;
+    if (!openArchive(segmentPath, a)) {
+        cout << RED << "No plan archive at " << segmentPath << RESET << "\n";
+        return 1;
+    }
+    string out;
+    appendPadded(out, "Issued", 22);
+    appendPadded(out, "Flight", 12);
+    appendPadded(out, "Model", 14);
+    out += "ULDs      Weight (kg)   CG arm  Flags\n";
+    size_t shown = 0;
+    for (size_t k = 0; k < a.count; ++k) {
+        PlanRecordView v;
+        if (!matchesFilter(a, a.entries[k], filter, v)) continue;
+        const PlanRecordHeader& h = *v.header;
+        appendPadded(out, formatIssued(a.entries[k].issuedAt), 22);
+        appendPadded(out, recordString(v, h.flightOffset, h.flightLength), 12);
+        appendPadded(out, recordString(v, h.modelOffset, h.modelLength), 14);
+        appendPadded(out, to_string(h.uldCount - h.unassigned) + "/" + to_string(h.uldCount), 10);
+        appendPadded(out, formatNumber(h.totalWeight), 14);
+        out += formatFixed2(h.cg);
+        if (h.flags & PLAN_RECORD_OVER_MTW) out += "  over MTW";
+        out += "\n";
+        ++shown;
+    }
+    out += to_string(shown) + " of " + to_string(a.count) + " archived plans\n";
+    cout << out;
+    return 0;
+}
+
+// Compare with last issued plan: ULDs added, removed or moved since, and the CG shift
+void printPlanChanges(string& out, const PlanRecordView& last, int64_t issuedAt, const LoadPlan& plan) {
+    out += "\nCompared with the plan issued " + formatIssued(issuedAt) + ":\n";
+    unordered_map<string, const PlanRecordULD*> before;
+    for (uint32_t i = 0; i < last.header->uldCount; ++i)
+        before[recordString(last, last.ulds[i].idOffset, last.ulds[i].idLength)] = &last.ulds[i];
+    auto label = [](const PlanRecordULD& r) { return r.start < 0 ? string("UNASSIGNED") : slotLabel(r.onMain != 0, r.start); };
+    size_t changes = 0;
+    for (size_t i = 0; i < plan.uldTable.ulds.size(); ++i) {
+        const ULD& u = plan.uldTable.ulds[i];
+        string now = slotLabel(plan.placements[i]);
+        auto it = before.find(u.id);
+        if (it == before.end()) { out += "  added   " + u.id + " -> " + now + "\n"; ++changes; continue; }
+        string was = label(*it->second);
+        if (was != now) { out += "  moved   " + u.id + ": " + was + " -> " + now + "\n"; ++changes; }
+        if (it->second->weight != u.weight) {
+            out += "  weight  " + u.id + ": " + formatNumber(it->second->weight) + " -> " + formatNumber(u.weight) + " kg\n";
+            ++changes;
+        }
+        before.erase(it);
+    }
+    for (uint32_t i = 0; i < last.header->uldCount; ++i) {
+        string id = recordString(last, last.ulds[i].idOffset, last.ulds[i].idLength);
+        if (before.count(id)) { out += "  removed " + id + " (was " + label(last.ulds[i]) + ")\n"; ++changes; }
+    }
+    if (changes == 0) out += "  no ULD changes\n";
+    out += "  CG arm " + formatFixed2(last.header->cg) + " -> " + formatFixed2(planCG(plan)) + ", total weight " +
+        formatNumber(last.header->totalWeight) + " -> " + formatNumber(plan.totalWeight) + " kg\n";
+}
+
+// Where a run's results go besides the text sink; an empty path means that format is off
+struct StructuredOutput {
+    string jsonPath, binaryPath, archivePath;
+    ofstream json, binary;
+    ArchiveWriter archive;
+};
+
+bool openStructuredOutput(StructuredOutput& out) {
+    if (!out.jsonPath.empty()) out.json.open(out.jsonPath, ios::binary);
+    if (!out.binaryPath.empty()) out.binary.open(out.binaryPath, ios::binary);
+    bool ok = (out.jsonPath.empty() || out.json.is_open()) && (out.binaryPath.empty() || out.binary.is_open());
+    if (!ok) cout << RED << "Failed to open " << (out.json.is_open() || out.jsonPath.empty() ? out.binaryPath : out.jsonPath)
+        << " for writing." << RESET << "\n";
+    if (ok && !out.archivePath.empty()) ok = openArchiveWriter(out.archivePath, out.archive);
+    return ok;
+}
+
+void writeStructured(ofstream& file, const string& buf) {
+    if (!file.is_open() || buf.empty()) return;
+    ScopedTimer timer(Phase::SAVE);
+    file.write(buf.data(), buf.size());
+}
+
+// A planned flight on its way from a planner to the writer: the result block, the console line
+// and, when those formats are on, its JSON line and binary record
+struct FlightResult {
+    string text;
+    string summary;
+    string jsonLine;
+    string record;
+    bool planned = false;
+};
+
+// Reorder buffer in front of the writer. A planner may hand in flight seq only while it is within
+// `window` of the next flight to write; the flight the writer waits for is always allowed in, so
+// planners can't all block behind it.
+struct ResultQueue {
+    mutex m;
+    condition_variable changed;
+    map<size_t, FlightResult> ready;
+    size_t next = 0;
+    size_t window = 64;
+    unsigned producers = 0; // planners still running
+};
+
+void pushResult(ResultQueue& q, size_t seq, FlightResult&& r) {
+    unique_lock<mutex> lock(q.m);
+    q.changed.wait(lock, [&] { return seq < q.next + q.window; });
+    q.ready.emplace(seq, std::move(r));
+    q.changed.notify_all();
+}
+
+void finishProducer(ResultQueue& q) {
+    lock_guard<mutex> lock(q.m);
+    q.producers--;
+    q.changed.notify_all();
+}
+
+// Next flight in manifest order; false once every planner has finished and all results are written
+bool popResult(ResultQueue& q, FlightResult& r) {
+    unique_lock<mutex> lock(q.m);
+    q.changed.wait(lock, [&] { return q.ready.count(q.next) || q.producers == 0; });
+    auto it = q.ready.find(q.next);
+    if (it == q.ready.end()) return false;
+    r = std::move(it->second);
+    q.ready.erase(it);
+    q.next++;
+    q.changed.notify_all();
+    return true;
+}
+
+// One flight, start to finish, on a planner thread: plan in the planner's own arena and format the
+// result block, so nothing of the plan outlives the arena's next reset
+// Which outputs a planner should build for each flight
+struct BatchFormats {
+    bool text = true, renderDecks = true, json = false, binary = false;
+};
+
+FlightResult planBatchFlight(const FlightManifest& f, const shared_ptr<const AircraftTemplate>& tmpl,
+    const ULDDB& ulddb, const PlanOptions& opts, FlightArena& arena, const BatchFormats& formats, unsigned whatIfThreads) {
+    FlightResult r;
+    if (formats.text) r.text = "\n##### Flight " + f.flightId + " (" + f.model + ") #####\n";
+    if (!tmpl) {
+        r.summary = f.flightId + ": unknown aircraft model '" + f.model + "', skipped\n";
+        if (formats.text) r.text += "Unknown aircraft model, not planned.\n";
+        return r;
+    }
+    resetFlightArena(arena);
+    LoadPlan plan = planFlight(tmpl, f.ulds, ulddb, opts, &arena);
+    int unassigned = countUnassigned(plan);
+    vector<WhatIfResult> whatIfs;
+    if (!f.whatIfs.empty()) whatIfs = evaluateWhatIfs(plan, f.whatIfs, whatIfThreads);
+
+    if (formats.text) {
+        printAssignmentResults(r.text, plan);
+        if (formats.renderDecks) {
+            printDeckColumnsASCII("Main", plan.tmpl->ac.mainDeck, plan.mainSlots, plan.uldTable.ulds, ulddb, r.text);
+            printDeckColumnsASCII("Lower", plan.tmpl->ac.lowerDeck, plan.lowerSlots, plan.uldTable.ulds, ulddb, r.text);
+        }
+        if (!whatIfs.empty()) printWhatIfResults(r.text, whatIfs);
+    }
+    if (formats.json) appendPlanJSONLine(r.jsonLine, f, plan, whatIfs);
+    if (formats.binary) appendPlanRecord(r.record, f, plan);
+
+    ostringstream line;
+    line << f.flightId << " (" << f.model << "): " << (f.ulds.size() - unassigned) << "/" << f.ulds.size()
+        << " ULDs assigned, " << plan.totalWeight << " kg\n";
+    r.summary = line.str();
+    r.planned = true;
+    return r;
+}
+
+// Plan every flight in the manifest against databases loaded once, writing one result block per flight.
+// Three stages joined by bounded queues: a reader thread parses the manifest, `threads` planners
+// (0 = one per core) each plan and format flights with their own arena and slot state, and the calling
+// thread writes the blocks and console lines in manifest order. The databases are shared read-only;
+// templates are looked up under a lock, since the cache (and a lazy aircraft DB) fill in on first use.
+// renderDecks=false skips the ASCII deck plans; `structured` adds JSON lines, binary records and/or
+// appends every planned flight to a plan archive.
+int runBatch(const string& manifestPath, const string& outPath, const PlanOptions& opts,
+    SinkMode sinkMode = SinkMode::FILE, bool renderDecks = true, bool lazyDB = false, unsigned threads = 0,
+    StructuredOutput* structured = nullptr) {
+    AircraftDB db;
+    ULDDB ulddb;
+    loadDatabases(db, ulddb, lazyDB);
+    if (ulddb.entries.empty()) {
+        cout << RED << "Warning: ULD database is empty or missing. Multi-slot ULDs may not be recognized." << RESET << "\n";
+    }
+
+    if (!ifstream(manifestPath)) {
+        cout << RED << "No flights read from manifest " << manifestPath << RESET << "\n";
+        return 1;
+    }
+
+    ofstream file;
+    if (sinkMode == SinkMode::FILE || sinkMode == SinkMode::BOTH) {
+        file.open(outPath, ios::binary);
+        if (!file.is_open()) {
+            cout << RED << "Failed to open " << outPath << " for writing." << RESET << "\n";
+            return 1;
+        }
+    }
+    OutputSink sink = makeSink(sinkMode, &file);
+    StructuredOutput noStructured;
+    StructuredOutput& extra = structured ? *structured : noStructured;
+    if (!openStructuredOutput(extra)) return 1;
+    BatchFormats formats;
+    formats.text = sink.console || sink.file;
+    formats.renderDecks = renderDecks;
+    formats.json = extra.json.is_open();
+    formats.binary = extra.binary.is_open() || extra.archive.segment.is_open();
+
+    FlightQueue queue;
+    bool readOk = true;
+    thread reader([&]() {
+        readOk = streamManifest(manifestPath, [&](FlightManifest&& f) { pushFlight(queue, std::move(f)); });
+        closeQueue(queue);
+    });
+
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    unsigned whatIfThreads = threads > 1 ? 1 : 0; // the planners already use every core
+    TemplateCache templates;
+    mutex templateMutex;
+    ResultQueue results;
+    results.producers = threads;
+    vector<thread> planners;
+    for (unsigned t = 0; t < threads; ++t) {
+        planners.emplace_back([&]() {
+            FlightArena arena;
+            size_t seq;
+            for (FlightManifest f; popFlight(queue, f, seq);) {
+                shared_ptr<const AircraftTemplate> tmpl;
+                {
+                    lock_guard<mutex> lock(templateMutex);
+                    tmpl = findTemplate(templates, db, f.model);
                 }
+                pushResult(results, seq, planBatchFlight(f, tmpl, ulddb, opts, arena, formats, whatIfThreads));
+            }
+            finishProducer(results);
+        });
+    }
+
+    int planned = 0, total = 0;
+    for (FlightResult r; popResult(results, r);) {
+        ++total;
+        if (!r.planned) cout << r.summary; // the warning goes ahead of the block, the summary after it
+        flushSink(sink, r.text);
+        writeStructured(extra.json, r.jsonLine);
+        writeStructured(extra.binary, r.record);
+        if (r.planned && extra.archive.segment.is_open() && !archivePlanRecord(extra.archive, r.record, unixNow()))
+            cout << RED << "Failed to archive the plan for " << r.summary << RESET;
+        if (r.planned) { cout << r.summary; ++planned; }
+    }
+    for (auto& t : planners) t.join();
+    reader.join();
+
+    if (!readOk) cout << RED << "Manifest " << manifestPath << " is not valid JSON; flights after the error were not read." << RESET << "\n";
+    if (total == 0) {
+        cout << RED << "No flights read from manifest " << manifestPath << RESET << "\n";
+        return 1;
+    }
+    cout << "Planned " << planned << " of " << total << " flights";
+    if (sink.file) cout << ", results saved to " << outPath;
+    if (formats.json) cout << ", JSON lines to " << extra.jsonPath;
+    if (extra.binary.is_open()) cout << ", binary records to " << extra.binaryPath;
+    if (extra.archive.segment.is_open()) cout << ", archived to " << extra.archivePath;
+    cout << "\n";
+    return 0;
+}
+
+// ===== Capacity sweep =====
+// Every aircraft in the DB x every ULD type in the ULD DB x fill level x nose/tail allowed or not,
+// each planned as a load of identical ULDs of that type: how many fit and where the CG ends up.
+// The fill level is the share of the slots the ULD type may use (its deck, or both for "Any")
+// that the requested ULDs would cover, so 100% asks for as many as could possibly fit.
+struct SweepCase {
+    string model;
+    shared_ptr<const AircraftTemplate> tmpl;
+    const ULDDBEntry* uld = nullptr;
+    int fillPct = 0;
+    bool allowSpecial = false;
+};
+
+struct SweepResult {
+    int requested = 0;
+    int assigned = 0;
+    double totalWeight = 0.0;
+    double cg = 0.0;
+    double mainWeight = 0.0;
+    double lowerWeight = 0.0;
+    bool overMTW = false;
+};
+
+SweepResult runSweepCase(const SweepCase& c, const ULDDB& ulddb, double uldWeight, const PlanOptions& opts) {
+    SweepResult r;
+    ULD::Type type = parseULDType(c.uld->deck);
+    int width = max(1, c.uld->widthSlots);
+    int usable = (type != ULD::Type::LOWER ? c.tmpl->mainLayout.count : 0)
+        + (type != ULD::Type::MAIN ? c.tmpl->lowerLayout.count : 0);
+    r.requested = (usable * c.fillPct + 100 * width - 1) / (100 * width);
+
+    vector<ULD> ulds(r.requested);
+    for (int i = 0; i < r.requested; ++i) {
+        ulds[i].id = c.uld->prefix + to_string(10000 + i);
+        ulds[i].weight = uldWeight;
+        ulds[i].type = type;
+        ulds[i].allowSpecialSlots = c.allowSpecial;
+    }
+    static thread_local FlightArena arena;
+    resetFlightArena(arena);
+    LoadPlan plan = planFlight(c.tmpl, ulds, ulddb, opts, &arena);
+    r.assigned = r.requested - countUnassigned(plan);
+    r.totalWeight = plan.totalWeight;
+    r.cg = planCG(plan);
+    r.mainWeight = plan.deckTotals[(int)DeckId::MAIN].weight;
+    r.lowerWeight = plan.deckTotals[(int)DeckId::LOWER].weight;
+    r.overMTW = plan.tmpl->ac.mtw > 0 && plan.totalWeight > plan.tmpl->ac.mtw;
+    return r;
+}
+
+// Quote a CSV field if it needs it
+string csvField(const string& s) {
+    if (s.find_first_of(",\"\n") == string::npos) return s;
+    string q = "\"";
+    for (char c : s) { if (c == '"') q += '"'; q += c; }
+    return q + "\"";
+}
+
+// Plan every sweep case on a work-stealing pool and write one CSV row per case, in a fixed order
+int runSweep(const string& outPath, const PlanOptions& opts, const vector<int>& fillLevels,
+    double uldWeight, unsigned threads) {
+    map<string, Aircraft> db;
+    ULDDB ulddb;
+    loadDatabases(db, ulddb);
+    if (db.empty() || ulddb.entries.empty()) {
+        cout << RED << "The capacity sweep needs both " << AIRCRAFT_DB_PATH << " and " << ULD_DB_PATH << RESET << "\n";
+        return 1;
+    }
+
+    // templates are built up front so the workers only read them
+    TemplateCache templates;
+    vector<SweepCase> cases;
+    for (auto& kv : db) {
+        auto tmpl = findTemplate(templates, db, kv.first);
+        for (auto& e : ulddb.entries)
+            for (int fill : fillLevels)
+                for (int allow = 0; allow < 2; ++allow)
+                    cases.push_back({ kv.first, tmpl, &e, fill, allow == 1 });
+    }
+
+    auto t0 = chrono::steady_clock::now();
+    vector<SweepResult> results(cases.size());
+    parallelFor(cases.size(), threads,
+        [&](size_t i) { results[i] = runSweepCase(cases[i], ulddb, uldWeight, opts); });
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    ofstream file(outPath, ios::binary);
+    if (!file.is_open()) {
+        cout << RED << "Failed to open " << outPath << " for writing." << RESET << "\n";
+        return 1;
+    }
+    string buf = "aircraft,prefix,uld_type,deck,width,allow_special,fill_pct,requested,assigned,"
+        "total_weight,cg_arm,main_weight,lower_weight,over_mtw\n";
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const SweepCase& c = cases[i];
+        const SweepResult& r = results[i];
+        buf += csvField(c.model) + "," + csvField(c.uld->prefix) + "," + csvField(c.uld->uldType) + ","
+            + csvField(c.uld->deck) + "," + to_string(max(1, c.uld->widthSlots)) + "," + (c.allowSpecial ? "1" : "0") + ","
+            + to_string(c.fillPct) + "," + to_string(r.requested) + "," + to_string(r.assigned) + ","
+            + formatNumber(r.totalWeight) + "," + formatFixed2(r.cg) + "," + formatNumber(r.mainWeight) + ","
+            + formatNumber(r.lowerWeight) + "," + (r.overMTW ? "1" : "0") + "\n";
+    }
+    file << buf;
+
+    cout << "Swept " << cases.size() << " cases (" << db.size() << " aircraft x " << ulddb.entries.size()
+        << " ULD types x " << fillLevels.size() << " fill levels x nose/tail on/off) in " << formatFixed2(secs)
+        << " s, results saved to " << outPath << "\n";
+    return 0;
+}
+
+// "25,50,100" -> {25, 50, 100}; false if any entry isn't a positive integer
+bool parseFillLevels(const string& s, vector<int>& levels) {
+    levels.clear();
+    stringstream ss(s);
+    string item;
+    while (getline(ss, item, ',')) {
+        size_t used = 0;
+        int v = stoi(item, &used);
+        if (used != item.size() || v <= 0) return false;
+        levels.push_back(v);
+    }
+    return !levels.empty();
+}
+
+// ===== Plan cache =====
+// Content-addressed cache of placements for the server. A flight's key is its aircraft model, the
+// planning options and the sorted multiset of its ULDs as (DB prefix, width, weight rounded to the
+// nearest multiple of the tolerance, deck type, nose/tail flag), so a rebooked flight with the same
+// load in another order, or with other serial numbers, hits. Rounding buckets weights: two within one
+// tolerance of each other can still fall either side of a boundary and miss. A hit replays the stored placements onto the request's ULDs
+// (interchangeable ULDs in manifest order), which gives exact weights and moments without running
+// placement. Bounded LRU; with a file, new entries are appended as JSON lines and the file is
+// compacted to the surviving entries when the cache is loaded at startup. Every key starts with the
+// FNV-1a hashes of the aircraft and ULD DB files it was planned on, so journal entries from other
+// DB contents are dropped on load instead of being replayed onto changed geometry.
+struct PlanCacheConfig {
+    size_t capacity = 0;         // entries; 0 = no cache
+    double weightTolerance = 1.0; // kg
+    string path;                 // "" = not persisted
+};
+
+struct PlanCacheEntry {
+    uint64_t hash = 0;
+    string key;                   // canonical flight, checked on a hit
+    vector<Placement> placements; // in canonical ULD order
+};
+
+struct PlanCache {
+    PlanCacheConfig cfg;
+    string salt; // DB the entries are planned on, see dbSalt
+    list<PlanCacheEntry> lru; // most recently used first
+    unordered_map<uint64_t, list<PlanCacheEntry>::iterator> byHash;
+};
+
+string dbSalt(uint64_t aircraftHash, uint64_t uldHash) {
+    char buf[40];
+    snprintf(buf, sizeof(buf), "db:%016llx.%016llx", (unsigned long long)aircraftHash, (unsigned long long)uldHash);
+    return buf;
+}
+
+// Canonical key of a flight; order[k] is the request ULD at canonical position k
+string canonicalFlight(const FlightManifest& f, const ULDDB& ulddb, const PlanOptions& opts, double tolerance,
+    const string& salt, vector<int>& order) {
+    vector<string> items(f.ulds.size());
+    for (size_t i = 0; i < f.ulds.size(); ++i) {
+        const ULD& u = f.ulds[i];
+        const ULDDBEntry* e = findULDEntry(ulddb, u.id);
+        long long weight = llround(u.weight / (tolerance > 0 ? tolerance : 1.0));
+        items[i] = (e ? e->prefix : string()) + "/" + to_string(e ? max(1, e->widthSlots) : 1) + "/" + to_string(weight)
+            + "/" + to_string((int)u.type) + "/" + (u.allowSpecialSlots ? "1" : "0");
+    }
+    order.resize(items.size());
+    for (size_t i = 0; i < order.size(); ++i) order[i] = (int)i;
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return items[a] != items[b] ? items[a] < items[b] : a < b; });
+
+    ostringstream key;
+    key << salt << "|" << f.model << "|" << (int)opts.engine << "|" << opts.targetCG << "|" << opts.timeBudgetMs << "|" << opts.beamWidth;
+    for (int i : order) key << "|" << items[i];
+    return key.str();
+}
+
+void insertPlanEntry(PlanCache& cache, PlanCacheEntry&& e) {
+    auto old = cache.byHash.find(e.hash);
+    if (old != cache.byHash.end()) { cache.lru.erase(old->second); cache.byHash.erase(old); }
+    cache.lru.push_front(std::move(e));
+    cache.byHash[cache.lru.front().hash] = cache.lru.begin();
+    while (cache.lru.size() > cache.cfg.capacity) {
+        cache.byHash.erase(cache.lru.back().hash);
+        cache.lru.pop_back();
+    }
+}
+
+json planEntryToJSON(const PlanCacheEntry& e) {
+    json placements = json::array();
+    for (auto& pl : e.placements) placements.push_back({ pl.start, pl.width, pl.onMain });
+    return { {"key", e.key}, {"placements", placements} };
+}
+
+// Read the journal (later lines are more recent) and rewrite it with the entries kept: those planned
+// on the DB files of cache.salt
+void loadPlanCache(PlanCache& cache) {
+    if (cache.cfg.path.empty() || cache.cfg.capacity == 0) return;
+    {
+        ifstream in(cache.cfg.path);
+        for (string line; getline(in, line);) {
+            try {
+                json j = json::parse(line);
+                PlanCacheEntry e;
+                e.key = j.at("key").get<string>();
+                if (e.key.compare(0, cache.salt.size() + 1, cache.salt + "|") != 0) continue;
+                e.hash = hashBytes(e.key.data(), e.key.size());
+                for (auto& p : j.at("placements")) e.placements.push_back({ p.at(0).get<int>(), p.at(1).get<int>(), p.at(2).get<bool>() });
+                insertPlanEntry(cache, std::move(e));
             }
-            if (!consecutive) continue;
+            catch (...) {} // a torn last line from a crash
+        }
+    }
+    ofstream out(cache.cfg.path, ios::binary | ios::trunc);
+    for (auto it = cache.lru.rbegin(); it != cache.lru.rend(); ++it) out << planEntryToJSON(*it).dump() << "\n";
+}
+
+// Forget every entry, in memory and in the file, e.g. when the databases they were planned on change
+void clearPlanCache(PlanCache& cache) {
+    cache.lru.clear();
+    cache.byHash.clear();
+    if (!cache.cfg.path.empty() && cache.cfg.capacity > 0) ofstream(cache.cfg.path, ios::binary | ios::trunc);
+}
+
+// Rebuild the request's plan from a cached entry; false (and the entry is dropped) if it no longer
+// fits the request or the template, e.g. a hand-edited or torn journal line, or the aircraft or ULD
+// DB changed since the entry was stored
+bool replayPlanEntry(PlanCache& cache, list<PlanCacheEntry>::iterator it, const vector<int>& order,
+    const vector<ULD>& ulds, const ULDDB& ulddb, LoadPlan& plan) {
+    const PlanCacheEntry& e = *it;
+    bool ok = e.placements.size() == ulds.size() && order.size() == ulds.size();
+    for (size_t k = 0; ok && k < order.size(); ++k)
+        ok = e.placements[k].width == max(1, getULDWidth(ulddb, ulds[order[k]].id));
+    if (!ok) { cache.byHash.erase(e.hash); cache.lru.erase(it); return false; }
+
+    fillULDTable(plan.uldTable, ulds);
+    plan.placements.assign(ulds.size(), Placement{});
+    for (size_t k = 0; k < order.size(); ++k) plan.placements[order[k]] = e.placements[k];
+    for (int h = 0; ok && h < (int)ulds.size(); ++h) {
+        const Placement& pl = plan.placements[h];
+        plan.report.push_back(h);
+        if (pl.start < 0) continue;
+        const ULD& u = ulds[h];
+        ok = !((pl.onMain && u.type == ULD::Type::LOWER) || (!pl.onMain && u.type == ULD::Type::MAIN))
+            && runAvailable(pl.onMain ? plan.mainBits : plan.lowerBits, pl.start, pl.width, u.allowSpecialSlots);
+        if (ok) placeULD(plan, u, h, pl.onMain, pl.start, pl.width);
+    }
+    if (!ok) { cache.byHash.erase(e.hash); cache.lru.erase(it); }
+    return ok;
+}
+
+// Plan through the cache; hit tells whether placement was skipped
+LoadPlan planFlightCached(PlanCache& cache, const FlightManifest& f, const shared_ptr<const AircraftTemplate>& tmpl,
+    const ULDDB& ulddb, const PlanOptions& opts, FlightArena& arena, bool& hit) {
+    hit = false;
+    if (cache.cfg.capacity == 0) return planFlight(tmpl, f.ulds, ulddb, opts, &arena);
 
-            // place ULD
-            for (int w = 0; w < uWidth; ++w) {
-                candidates[i + w]->occupied = true;
-                candidates[i + w]->occupantId = u.id;
-                candidates[i + w]->occupantWeight = u.weight / uWidth;
+    vector<int> order;
+    string key = canonicalFlight(f, ulddb, opts, cache.cfg.weightTolerance, cache.salt, order);
+    uint64_t hash = hashBytes(key.data(), key.size());
+    auto found = cache.byHash.find(hash);
+    if (found != cache.byHash.end() && found->second->key == key) {
+        cache.lru.splice(cache.lru.begin(), cache.lru, found->second);
+        {
+            LoadPlan plan = makeEmptyPlan(tmpl, &arena.plan);
+            if (replayPlanEntry(cache, found->second, order, f.ulds, ulddb, plan)) {
+                countEvent(Counter::PLAN_CACHE_HITS);
+                hit = true;
+                return plan;
             }
+        }
+        resetFlightArena(arena);
+    }
+    countEvent(Counter::PLAN_CACHE_MISSES);
+
+    LoadPlan plan = planFlight(tmpl, f.ulds, ulddb, opts, &arena);
+    PlanCacheEntry e;
+    e.hash = hash;
+    e.key = std::move(key);
+    for (int h : order) e.placements.push_back(plan.placements[h]);
+    if (!cache.cfg.path.empty()) {
+        ofstream out(cache.cfg.path, ios::binary | ios::app);
+        out << planEntryToJSON(e).dump() << "\n";
+    }
+    insertPlanEntry(cache, std::move(e));
+    return plan;
+}
+
+// ===== Server mode =====
+// Long-running planner: databases are loaded once and a template per aircraft model is kept,
+// so a request only sets up empty occupancy and runs placement. The protocol is one JSON object per
+// line in each direction. A request is a manifest flight object, optionally with
+// "engine": "greedy" | "optimize" | "lower-dp"; the response carries the "Assignment Results" as JSON.
+//
+// The databases and templates form a snapshot. A watcher thread notices when either DB file changes and
+// loads a new snapshot off the request path, templates included. It then publishes the snapshot with
+// an atomic shared_ptr store. Each request takes the snapshot current when it starts and finishes on
+// it, even if a newer one is published meanwhile. A published snapshot is only touched by the request
+// thread (lazy lookups and templates fill in on first use), never by the watcher.
+struct DBSnapshot {
+    AircraftDB db;
+    ULDDB ulddb;
+    TemplateCache templates;
+    uint64_t aircraftHash = 0, uldHash = 0; // of the JSON files it was loaded from
+    unsigned generation = 1;
+};
+
+struct ServerState {
+    shared_ptr<DBSnapshot> snapshot; // read and replaced with atomic_load / atomic_store only
+    PlanOptions opts;
+    FlightArena arena; // requests are handled one at a time
+    PlanCache cache;
+    unsigned cacheGeneration = 1; // snapshot the cached plans were made on
+    bool lazyDB = false;
+};
+
+shared_ptr<DBSnapshot> loadSnapshot(bool lazyDB) {
+    auto snap = make_shared<DBSnapshot>();
+    snap->aircraftHash = hashFile(AIRCRAFT_DB_PATH);
+    snap->uldHash = hashFile(ULD_DB_PATH);
+    loadDatabases(snap->db, snap->ulddb, lazyDB);
+    if (!lazyDB) // warm every template up front; lazily, each is built on its model's first request
+        for (auto& kv : snap->db.parsed) findTemplate(snap->templates, snap->db, kv.first);
+    return snap;
+}
+
+struct DBWatcher {
+    thread worker;
+    mutex m;
+    condition_variable wake;
+    bool stop = false;
+};
+
+struct FileStamp {
+    filesystem::file_time_type time{};
+    uintmax_t size = 0;
+    bool operator==(const FileStamp& o) const { return time == o.time && size == o.size; }
+};
+
+FileStamp fileStamp(const string& path) {
+    error_code ec;
+    FileStamp st;
+    st.time = filesystem::last_write_time(path, ec);
+    st.size = ec ? 0 : filesystem::file_size(path, ec);
+    return st;
+}
 
-            currentWeight += u.weight;
-            currentMoment += u.weight * candidates[i]->arm;
+// Poll the DB files' size and mtime every intervalMs and publish a fresh snapshot when their content
+// changed. A file still being written (its hash moved while loading) is retried on the next tick. An
+// edit that leaves either database empty, e.g. a JSON syntax error, keeps the current snapshot. The
+// snapshot replaced last is released here once no request holds it, so freeing it never lands on a request.
+void watchDatabases(ServerState& st, DBWatcher& w, int intervalMs) {
+    FileStamp aircraft = fileStamp(AIRCRAFT_DB_PATH), uld = fileStamp(ULD_DB_PATH);
+    shared_ptr<DBSnapshot> retired;
+    unique_lock<mutex> lock(w.m);
+    while (!w.wake.wait_for(lock, chrono::milliseconds(intervalMs), [&] { return w.stop; })) {
+        if (retired && retired.use_count() == 1) retired.reset();
+        FileStamp a = fileStamp(AIRCRAFT_DB_PATH), u = fileStamp(ULD_DB_PATH);
+        if (a == aircraft && u == uld) continue;
+        lock.unlock();
+        shared_ptr<DBSnapshot> current = atomic_load(&st.snapshot);
+        shared_ptr<DBSnapshot> next = loadSnapshot(st.lazyDB);
+        bool settled = next->aircraftHash == hashFile(AIRCRAFT_DB_PATH) && next->uldHash == hashFile(ULD_DB_PATH);
+        if (settled) {
+            aircraft = a; uld = u;
+            if (next->aircraftHash == current->aircraftHash && next->uldHash == current->uldHash) {} // touched, not changed
+            else if (aircraftCount(next->db) == 0 || next->ulddb.entries.empty())
+                cerr << "Database reload skipped: " << (aircraftCount(next->db) == 0 ? AIRCRAFT_DB_PATH : ULD_DB_PATH)
+                    << " is empty or not valid JSON; still serving the previous databases\n";
+            else {
+                next->generation = current->generation + 1;
+                atomic_store(&st.snapshot, next);
+                retired = std::move(current);
+                cerr << "Reloaded databases (generation " << next->generation << "): " << aircraftCount(next->db)
+                    << " aircraft, " << next->ulddb.entries.size() << " ULD types\n";
+            }
+        }
+        lock.lock();
+    }
+}
 
-            report.emplace_back(u.id,
-                candidates[i]->deckName + "[" + to_string(candidates[i]->index + 1) + "]");
-            placed = true;
-            break;
+string handlePlanRequest(ServerState& st, const string& line) {
+    json response;
+    try {
+        json req = json::parse(line);
+        if (req.contains("metrics")) {
+            if (!g_metrics.enabled) response = { {"error", "metrics are off; start the server with --metrics json|prometheus"} };
+            else if (g_metrics.format == MetricsFormat::PROMETHEUS) response = { {"metrics", metricsPrometheus()} };
+            else response = { {"metrics", metricsJSON()} };
+            return response.dump();
         }
+        FlightManifest f;
+        parseFlightJSON(req, f);
+        shared_ptr<DBSnapshot> snap = atomic_load(&st.snapshot);
+        if (snap->generation != st.cacheGeneration) { // cached placements were made on the old databases
+            clearPlanCache(st.cache);
+            st.cache.salt = dbSalt(snap->aircraftHash, snap->uldHash);
+            st.cacheGeneration = snap->generation;
+        }
+        PlanOptions opts = st.opts;
+        string engine = req.value("engine", "");
+        if (engine == "optimize") opts.engine = PlanEngine::OPTIMIZE;
+        else if (engine == "greedy") opts.engine = PlanEngine::GREEDY;
+        else if (engine == "lower-dp") opts.engine = PlanEngine::LOWER_DP;
 
-        if (!placed) {
-            report.emplace_back(u.id, "UNASSIGNED");
+        auto tmpl = findTemplate(snap->templates, snap->db, f.model);
+        if (!tmpl) {
+            response = { {"flight", f.flightId}, {"error", "unknown aircraft model '" + f.model + "'"} };
+        }
+        else {
+            resetFlightArena(st.arena);
+            bool cached;
+            LoadPlan plan = planFlightCached(st.cache, f, tmpl, snap->ulddb, opts, st.arena, cached);
+            response = planToJSON(f, plan);
+            if (cached) response["cached"] = true;
+            // inline: a what-if is a few slot checks, far cheaper than starting threads per request
+            if (!f.whatIfs.empty()) response["whatIf"] = whatIfsToJSON(evaluateWhatIfs(plan, f.whatIfs, 1));
         }
+    }
+    catch (const exception& e) {
+        response = { {"error", string("bad request: ") + e.what()} };
+    }
+    return response.dump();
+}
+
+#ifdef _WIN32
+typedef SOCKET socket_t;
+#else
+typedef int socket_t;
+const socket_t INVALID_SOCKET = -1;
+#define closesocket close
+#endif
+
+bool sendAll(socket_t sock, const string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+#ifdef MSG_NOSIGNAL
+        int n = (int)send(sock, data.data() + sent, (int)(data.size() - sent), MSG_NOSIGNAL); // no SIGPIPE if the client hung up
+#else
+        int n = (int)send(sock, data.data() + sent, (int)(data.size() - sent), 0);
+#endif
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
 
-        // cleanup: remove occupied from freeSlots
-        freeSlots.erase(std::remove_if(freeSlots.begin(), freeSlots.end(),
-            [](Slot* s) { return s->occupied; }), freeSlots.end());
+// Serve line-delimited requests on 127.0.0.1:port, one connection at a time
+int serveSocket(ServerState& st, int port) {
+#ifdef _WIN32
+    WSADATA wsa;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) return 1;
+#endif
+    socket_t listener = socket(AF_INET, SOCK_STREAM, 0);
+    if (listener == INVALID_SOCKET) return 1;
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((unsigned short)port);
+    if (::bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 8) != 0) {
+        cerr << "Cannot listen on 127.0.0.1:" << port << "\n";
+        closesocket(listener);
+        return 1;
     }
+    cerr << "Listening on 127.0.0.1:" << port << "\n";
 
-    // report
-    cout << "\n=== Assignment Results ===\n";
-    cout << left << setw(12) << "ULD ID" << setw(22) << "Assigned Slot" << setw(10) << "Weight(kg)" << "\n";
-    cout << string(46, '-') << "\n";
-    for (auto& x : report) {
-        double w = 0; for (auto& u : ulds) if (u.id == x.first) { w = u.weight; break; }
-        cout << left << setw(12) << x.first << setw(22) << x.second << setw(10) << w << "\n";
+    while (true) {
+        socket_t client = accept(listener, nullptr, nullptr);
+        if (client == INVALID_SOCKET) continue;
+        string pending;
+        char buf[4096];
+        int n;
+        while ((n = (int)recv(client, buf, sizeof(buf), 0)) > 0) {
+            pending.append(buf, n);
+            size_t pos;
+            bool ok = true;
+            while (ok && (pos = pending.find('\n')) != string::npos) {
+                string line = pending.substr(0, pos);
+                pending.erase(0, pos + 1);
+                if (!line.empty() && line.back() == '\r') line.pop_back();
+                if (!line.empty()) ok = sendAll(client, handlePlanRequest(st, line) + "\n");
+            }
+            if (!ok) break;
+        }
+        closesocket(client);
+    }
+}
+
+// port <= 0: requests on stdin, responses on stdout. reloadMs > 0 watches the DB files at that interval.
+int runServer(const PlanOptions& opts, int port, bool lazyDB = false, const PlanCacheConfig& cacheCfg = PlanCacheConfig(),
+    int reloadMs = 1000) {
+    ServerState st;
+    st.opts = opts;
+    st.lazyDB = lazyDB;
+    st.cache.cfg = cacheCfg;
+    st.snapshot = loadSnapshot(lazyDB);
+    st.cache.salt = dbSalt(st.snapshot->aircraftHash, st.snapshot->uldHash);
+    loadPlanCache(st.cache);
+    cerr << (lazyDB ? "Indexed " : "Loaded ") << aircraftCount(st.snapshot->db) << " aircraft, "
+        << st.snapshot->ulddb.entries.size() << " ULD types\n";
+    if (cacheCfg.capacity > 0) cerr << "Plan cache: " << st.cache.lru.size() << " of " << cacheCfg.capacity << " entries loaded\n";
+
+    DBWatcher watcher;
+    if (reloadMs > 0) watcher.worker = thread(watchDatabases, ref(st), ref(watcher), reloadMs);
+    int rc = 0;
+    if (port > 0) rc = serveSocket(st, port);
+    else {
+        string line;
+        while (getline(cin, line)) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (line.empty()) continue;
+            cout << handlePlanRequest(st, line) << "\n" << flush;
+        }
+    }
+    if (watcher.worker.joinable()) {
+        { lock_guard<mutex> lock(watcher.m); watcher.stop = true; }
+        watcher.wake.notify_all();
+        watcher.worker.join();
+    }
+    return rc;
+}
+
+// LOADCALC_NO_MAIN lets other programs (LoadCalc_Bench.cpp) include this file for the planner alone
+#ifndef LOADCALC_NO_MAIN
+int main(int argc, char* argv[]) {
+    ios::sync_with_stdio(false); cin.tie(nullptr);
+
+    // Non-interactive batch mode: LoadCalc_CPP --batch <manifest.json|.csv> [--out <file>]
+    string manifestPath, outPath;
+    PlanOptions opts;
+    SinkMode sinkMode = SinkMode::FILE;
+    bool renderDecks = true;
+    bool compileDB = false, serve = false, sweep = false, lazyDB = false;
+    int port = 0, reloadMs = 1000;
+    vector<int> fillLevels{ 25, 50, 75, 100 };
+    double sweepWeight = 1000.0;
+    unsigned threads = 0;
+    string metricsPath;
+    PlanCacheConfig planCache;
+    StructuredOutput structured;
+    string archiveQueryPath, flightId;
+    ArchiveFilter archiveFilter;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        try {
+            if (arg == "--batch" && i + 1 < argc) manifestPath = argv[++i];
+            else if (arg == "--out" && i + 1 < argc) outPath = argv[++i];
+            else if (arg == "--sink" && i + 1 < argc) { if (!parseSinkMode(argv[++i], sinkMode)) throw invalid_argument(arg); }
+            else if (arg == "--no-render") renderDecks = false;
+            else if (arg == "--json-out" && i + 1 < argc) structured.jsonPath = argv[++i];
+            else if (arg == "--bin-out" && i + 1 < argc) structured.binaryPath = argv[++i];
+            else if (arg == "--archive" && i + 1 < argc) structured.archivePath = argv[++i];
+            else if (arg == "--archive-query" && i + 1 < argc) archiveQueryPath = argv[++i];
+            else if (arg == "--flight" && i + 1 < argc) flightId = argv[++i];
+            else if (arg == "--model" && i + 1 < argc) archiveFilter.model = argv[++i];
+            else if (arg == "--date" && i + 1 < argc) { if (!parseArchiveDate(argv[++i], archiveFilter.date)) throw invalid_argument(arg); }
+            else if (arg == "--optimize") opts.engine = PlanEngine::OPTIMIZE;
+            else if (arg == "--lower-dp") opts.engine = PlanEngine::LOWER_DP;
+            else if (arg == "--target-cg" && i + 1 < argc) opts.targetCG = stod(argv[++i]);
+            else if (arg == "--budget-ms" && i + 1 < argc) opts.timeBudgetMs = stoi(argv[++i]);
+            else if (arg == "--compile-db") compileDB = true;
+            else if (arg == "--lazy-db") lazyDB = true;
+            else if (arg == "--serve") serve = true;
+            else if (arg == "--port" && i + 1 < argc) port = stoi(argv[++i]);
+            else if (arg == "--reload-ms" && i + 1 < argc) reloadMs = stoi(argv[++i]);
+            else if (arg == "--plan-cache" && i + 1 < argc) planCache.capacity = stoul(argv[++i]);
+            else if (arg == "--plan-cache-file" && i + 1 < argc) planCache.path = argv[++i];
+            else if (arg == "--plan-cache-tol" && i + 1 < argc) planCache.weightTolerance = stod(argv[++i]);
+            else if (arg == "--sweep") sweep = true;
+            else if (arg == "--fill" && i + 1 < argc) { if (!parseFillLevels(argv[++i], fillLevels)) throw invalid_argument(arg); }
+            else if (arg == "--uld-weight" && i + 1 < argc) sweepWeight = stod(argv[++i]);
+            else if (arg == "--threads" && i + 1 < argc) threads = (unsigned)stoul(argv[++i]);
+            else if (arg == "--metrics" && i + 1 < argc) {
+                if (!parseMetricsFormat(argv[++i], g_metrics.format)) throw invalid_argument(arg);
+                g_metrics.enabled = true;
+            }
+            else if (arg == "--metrics-out" && i + 1 < argc) metricsPath = argv[++i];
+            else throw invalid_argument(arg);
+        }
+        catch (...) {
+            cout << "Usage: " << argv[0] << " [--batch <manifest.json|manifest.csv> [--out <file>] [--sink file|console|both|none] [--no-render] [--threads <n>]]\n"
+                << "       [--json-out <file.jsonl>] [--bin-out <file.bin>] [--archive <file>]   (batch and interactive mode)\n"
+                << "       interactive mode: [--flight <id>]   (names the flight in structured output and the archive)\n"
+                << "       " << argv[0] << " --archive-query <file> [--flight <id>] [--model <model>] [--date YYYY-MM-DD]\n"
+                << "       [--optimize [--target-cg <arm>] [--budget-ms <ms>] | --lower-dp [--target-cg <arm>]]\n"
+                << "       " << argv[0] << " --compile-db\n"
+                << "       " << argv[0] << " --serve [--port <n>] [--reload-ms <ms>] [--optimize ...] [--plan-cache <entries> [--plan-cache-file <file>] [--plan-cache-tol <kg>]]\n"
+                << "       " << argv[0] << " --sweep [--out <file.csv>] [--fill <pct,pct,...>] [--uld-weight <kg>] [--threads <n>] [--optimize ...]\n"
+                << "       any mode: [--metrics json|prometheus [--metrics-out <file>]]\n"
+                << "       interactive, batch and server mode: [--lazy-db]\n";
+            return 1;
+        }
+    }
+    if (compileDB) {
+        if (!compileDBImage(AIRCRAFT_DB_PATH, ULD_DB_PATH, DB_IMAGE_PATH)) {
+            cout << RED << "Failed to compile " << DB_IMAGE_PATH << RESET << "\n";
+            return 1;
+        }
+        cout << "Compiled " << AIRCRAFT_DB_PATH << " and " << ULD_DB_PATH << " into " << DB_IMAGE_PATH << "\n";
+        return 0;
+    }
+    auto finish = [&](int rc) {
+        if (g_metrics.enabled) writeMetrics(metricsPath);
+        return rc;
+    };
+    if (!archiveQueryPath.empty()) {
+        archiveFilter.flight = flightId;
+        return finish(runArchiveQuery(archiveQueryPath, archiveFilter));
+    }
+    if (serve) return finish(runServer(opts, port, lazyDB, planCache, reloadMs));
+    if (sweep) return finish(runSweep(outPath.empty() ? "capacity_sweep.csv" : outPath, opts, fillLevels, sweepWeight, threads));
+    if (!manifestPath.empty())
+        return finish(runBatch(manifestPath, outPath.empty() ? "batch_results.txt" : outPath, opts, sinkMode, renderDecks, lazyDB, threads, &structured));
+
+    AircraftDB db;
+    ULDDB ulddb;
+    loadDatabases(db, ulddb, lazyDB);
+    cout << "=== Manual ULD Load Planner ===\n";
+
+    if (aircraftCount(db) > 0) { cout << "Aircraft in DB:\n"; for (auto& m : aircraftModels(db)) cout << " - " << m << "\n"; }
+
+    cout << "Enter aircraft model: ";
+    string model; getline(cin, model);
+    Aircraft ac;
+    const Aircraft* entry = model.empty() ? nullptr : findAircraft(db, model);
+    if (entry) {
+        ac = *entry;
+        cout << "Using DB entry for " << model << "\n";
+    }
+    else {
+        cout << "Custom aircraft\n";
+        cout << "Main deck slots: "; cin >> ac.mainDeck.slots;
+        cout << "Lower deck slots: "; cin >> ac.lowerDeck.slots; cin.ignore();
+        ac.model = model.empty() ? "CUSTOM" : model;
+    }
+
+    // assign greedily (safe version with multi-slot placement)
+    vector<ULD> ulds;
+    int nULDs = promptInt("Number of ULDs: ");
+    for (int i = 0; i < nULDs; ++i) {
+        ULD u;
+        while (true) {
+            cout << "ULD #" << (i + 1) << " ID: ";
+            getline(cin, u.id);
+            if (!u.id.empty()) break;
+        }
+        u.weight = promptDouble("ULD " + u.id + " weight (kg): ");
+        cout << "ULD type (MAIN / LOWER / ANY): ";
+        string t; getline(cin, t);
+        u.type = parseULDType(t);
+        cout << "Allow nose/tail? (y/n): "; getline(cin, t);
+        u.allowSpecialSlots = parseYesNo(t);
+        ulds.push_back(u);
+    }
+
+    // Add a check for empty DBs after loading:
+    if (ulddb.entries.empty()) {
+        cout << RED << "Warning: ULD database is empty or missing. Multi-slot ULDs may not be recognized." << RESET << "\n";
+    }
+    if (aircraftCount(db) == 0) {
+        cout << RED << "Warning: Aircraft database is empty or missing. Only custom aircraft can be entered." << RESET << "\n";
     }
 
+    PlanEditor ed;
+    ed.plan = planFlight(ac, ulds, ulddb, opts);
+    const LoadPlan& plan = ed.plan;
+
+    // report
+    string buf;
+    printAssignmentResults(buf, plan);
+    flushSink(makeSink(SinkMode::CONSOLE, nullptr), buf);
+
     // Print decks
-    vector<string> loadPlanLines;
-    printDeckColumnsASCII("Main", ac.mainDeck, mainSlots, ulddb, &loadPlanLines);
-    printDeckColumnsASCII("Lower", ac.lowerDeck, lowerSlots, ulddb, &loadPlanLines);
+    printDeckColumnsASCII("Main", plan.tmpl->ac.mainDeck, plan.mainSlots, plan.uldTable.ulds, ulddb, buf);
+    printDeckColumnsASCII("Lower", plan.tmpl->ac.lowerDeck, plan.lowerSlots, plan.uldTable.ulds, ulddb, buf);
+    cout << buf;
+
+    // Manual adjustments, one ULD at a time
+    cout << "\nAdjust plan: move <ULD ID> <main|lower> <slot #>, offload <ULD ID>, undo, redo, done\n"
+        << "Late changes: add <ULD ID> <kg> <main|lower|any> [y/n nose/tail], remove <ULD ID>, weigh <ULD ID> <kg>\n";
+    bool edited = false;
+    for (string line; cout << "> " << flush && getline(cin, line);) {
+        istringstream cmd(line);
+        string op, id, deck;
+        int slot = 0;
+        cmd >> op >> id;
+        bool ok;
+        if (op.empty() || op == "done") break;
+        else if (op == "undo") ok = undoEdit(ed);
+        else if (op == "redo") ok = redoEdit(ed);
+        else if (op == "offload") ok = offloadULD(ed, findULD(plan.uldTable, id));
+        else if (op == "move" && cmd >> deck >> slot && parseULDType(deck) != ULD::Type::ANY)
+            ok = moveULD(ed, findULD(plan.uldTable, id), parseULDType(deck) == ULD::Type::MAIN, slot - 1);
+        else if (op == "add" || op == "remove" || op == "weigh") {
+            PlanDelta d;
+            double kg = 0.0;
+            if (op == "remove") d.removed.push_back(id);
+            else if (!(cmd >> kg)) { cout << "Unknown command\n"; continue; }
+            else if (op == "weigh") d.reweighed.emplace_back(id, kg);
+            else {
+                ULD u;
+                u.id = id;
+                u.weight = kg;
+                string special;
+                cmd >> deck >> special;
+                u.type = parseULDType(deck);
+                u.allowSpecialSlots = parseYesNo(special);
+                d.added.push_back(u);
+            }
+            vector<PlanChange> changes;
+            if (!replanDelta(ed.plan, d, ulddb, changes)) { cout << RED << "No ULD " << id << " in the plan" << RESET << "\n"; continue; }
+            ed.undoStack.clear(); // handles may have shifted; manifest changes aren't undoable
+            ed.redoStack.clear();
+            edited = true;
+            buf.clear();
+            printPlanDelta(buf, plan, changes);
+            cout << buf;
+            continue;
+        }
+        else { cout << "Unknown command\n"; continue; }
+
+        if (!ok) { cout << RED << "Not possible" << RESET << "\n"; continue; }
+        edited = true;
+        cout << "Total weight: " << formatNumber(plan.totalWeight) << " kg, CG arm: " << formatFixed2(planCG(plan))
+            << " (main " << formatNumber(plan.deckTotals[(int)DeckId::MAIN].weight) << " kg, lower "
+            << formatNumber(plan.deckTotals[(int)DeckId::LOWER].weight) << " kg)\n";
+    }
+    if (edited) {
+        buf.clear();
+        printAssignmentResults(buf, plan);
+        flushSink(makeSink(SinkMode::CONSOLE, nullptr), buf);
+        printDeckColumnsASCII("Main", plan.tmpl->ac.mainDeck, plan.mainSlots, plan.uldTable.ulds, ulddb, buf);
+        printDeckColumnsASCII("Lower", plan.tmpl->ac.lowerDeck, plan.lowerSlots, plan.uldTable.ulds, ulddb, buf);
+        cout << buf;
+    }
 
-    if (saveLoadPlanToFile("loadplan.txt", loadPlanLines)) {
+    if (saveLoadPlanToFile("loadplan.txt", buf)) {
         cout << "Load plan saved to loadplan.txt\n";
     }
     else {
         cout << "Failed to save load plan.\n";
     }
+    if (!structured.jsonPath.empty() || !structured.binaryPath.empty() || !structured.archivePath.empty()) {
+        FlightManifest single;
+        single.flightId = flightId;
+        single.model = ac.model;
+        if (openStructuredOutput(structured)) {
+            string out, record;
+            appendPlanRecord(record, single, plan);
+            if (structured.json.is_open()) { appendPlanJSONLine(out, single, plan, {}); writeStructured(structured.json, out); }
+            writeStructured(structured.binary, record);
+            if (structured.json.is_open()) cout << "JSON line saved to " << structured.jsonPath << "\n";
+            if (structured.binary.is_open()) cout << "Binary record saved to " << structured.binaryPath << "\n";
+            if (structured.archive.segment.is_open()) {
+                PlanArchive archive;
+                PlanRecordView last;
+                int64_t issuedAt = 0;
+                if (openArchive(structured.archivePath, archive) && findLastIssued(archive, single.flightId, single.model, last, issuedAt)) {
+                    out.clear();
+                    printPlanChanges(out, last, issuedAt, plan);
+                    cout << out;
+                }
+                else cout << "No earlier plan for this flight in " << structured.archivePath << "\n";
+                if (archivePlanRecord(structured.archive, record, unixNow())) cout << "Plan archived to " << structured.archivePath << "\n";
+                else cout << RED << "Failed to archive the plan." << RESET << "\n";
+            }
+        }
+    }
 
     cout << "\nDone.\n";
-    return 0;
+    return finish(0);
 }
+#endif